@@ -0,0 +1,308 @@
+'use strict';
+
+// Compares the native maps against the built-in Map over every operation,
+// key type and size. Each map / key type / size runs in a fresh node
+// process, so its memory and GC numbers are its own, and the results are
+// written out as JSON so runs can be compared over time.
+//
+//   npm run bench -- [--sizes 1e3,1e4,1e5,1e6,1e7] [--keys number,string,object,mixed]
+//                    [--maps builtin,native,...] [--ops 1e5] [--out file.json]
+//   node bench/index.js --compare old.json new.json [--threshold 0.1]
+//
+// For every operation it records ops/sec, the 99th percentile latency and
+// the time spent in GC. A single operation is too quick to time on its
+// own, so latency is taken over batches of kBatch operations and divided
+// down.
+
+const childProcess = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const kBatch = 100;
+
+// every kind of map, made empty or from an array of pairs. The native ones
+// are only loaded in the process that uses them
+const maps = {
+  builtin: {make: (pairs) => new Map(pairs)},
+  native: {make: (pairs) => new (require('..'))(pairs)},
+  'native-ordered': {make: (pairs) => new (require('..'))(pairs, {ordered: true})},
+  'native-array': {make: (pairs) => new (require('..'))(pairs, {store: 'array'})},
+  NumberMap: {keys: ['number'], make: (pairs) => new (require('..').NumberMap)(pairs)},
+  StringMap: {keys: ['string'], make: (pairs) => new (require('..').StringMap)(pairs)},
+};
+
+const keyTypes = ['number', 'string', 'object', 'mixed'];
+
+// --name value pairs, and anything else in args._
+function parseArgs(argv) {
+  const args = {_: []};
+  for (let i = 0; i < argv.length; i++) {
+    if (argv[i].startsWith('--')) {
+      args[argv[i].slice(2)] = argv[i + 1] !== undefined && !argv[i + 1].startsWith('--') ? argv[++i] : true;
+    } else {
+      args._.push(argv[i]);
+    }
+  }
+  return args;
+}
+
+function list(value, fallback) {
+  return value ? String(value).split(',') : fallback;
+}
+
+// the same keys on every run: a small xorshift generator seeded per size
+function makeKeys(type, count, seed) {
+  let state = seed | 1;
+  const random = () => {
+    state ^= state << 13;
+    state ^= state >>> 17;
+    state ^= state << 5;
+    return state >>> 0;
+  };
+  const make = (i, kind) => {
+    switch (kind) {
+      case 'number': return i * 8 + (random() & 7);
+      case 'string': return `key:${i.toString(36)}:${random().toString(36)}`;
+      case 'object': return {id: i};
+      default: return make(i, keyTypes[i % 3]);
+    }
+  };
+  const keys = new Array(count);
+  for (let i = 0; i < count; i++) {
+    keys[i] = make(i, type);
+  }
+  return keys;
+}
+
+function percentile(sorted, fraction) {
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * fraction))];
+}
+
+const tick = () => new Promise((resolve) => setImmediate(resolve));
+
+// runs a single map / key type / size and prints its results as JSON
+async function runCase(options) {
+  const {PerformanceObserver} = require('perf_hooks');
+  const size = options.size;
+  const minOps = Math.max(size, options.ops);
+  const keys = makeKeys(options.keys, size, 0x9e3779b9 ^ size);
+  // keys of the same type that are never set, for lookups that miss
+  const misses = makeKeys(options.keys, size, 0x85ebca6b ^ size).map((key, i) => (
+    typeof key === 'number' ? key + 0.5 : typeof key === 'string' ? `${key}:miss` : {id: -i}
+  ));
+  const pairs = keys.map((key, i) => [key, i]);
+  const make = maps[options.map].make;
+
+  let gcTime = 0;
+  const observer = new PerformanceObserver((list) => {
+    list.getEntries().forEach((entry) => {
+      gcTime += entry.duration;
+    });
+  });
+  observer.observe({entryTypes: ['gc']});
+
+  // times fn(i) for at least count calls, in batches
+  async function measure(count, fn) {
+    const batches = [];
+    await tick();
+    gcTime = 0;
+    const start = process.hrtime.bigint();
+    for (let done = 0; done < count; done += kBatch) {
+      const batchStart = process.hrtime.bigint();
+      for (let i = done; i < done + kBatch; i++) {
+        fn(i);
+      }
+      batches.push(Number(process.hrtime.bigint() - batchStart) / kBatch);
+    }
+    const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+    await tick();
+    batches.sort((a, b) => a - b);
+    return {
+      opsPerSec: Math.round(batches.length * kBatch / seconds),
+      p99Ns: Math.round(percentile(batches, 0.99)),
+      gcMs: Number(gcTime.toFixed(3)),
+    };
+  }
+
+  // operations that go over the whole map are timed once per round, with
+  // as many rounds as it takes to reach minOps
+  async function measureWhole(fn) {
+    const rounds = Math.max(1, Math.ceil(minOps / size));
+    const times = [];
+    await tick();
+    gcTime = 0;
+    const start = process.hrtime.bigint();
+    for (let round = 0; round < rounds; round++) {
+      const roundStart = process.hrtime.bigint();
+      fn(round);
+      times.push(Number(process.hrtime.bigint() - roundStart) / size);
+    }
+    const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+    await tick();
+    times.sort((a, b) => a - b);
+    return {
+      opsPerSec: Math.round(rounds * size / seconds),
+      p99Ns: Math.round(percentile(times, 0.99)),
+      gcMs: Number(gcTime.toFixed(3)),
+    };
+  }
+
+  const results = {};
+  const collect = () => {
+    if (global.gc) {
+      global.gc();
+    }
+  };
+
+  collect();
+  const before = process.memoryUsage();
+  let map = make();
+  results.set = await measure(size, (i) => {
+    if (i < size) {
+      map.set(keys[i], i);
+    }
+  });
+  collect();
+  const after = process.memoryUsage();
+  const memory = {
+    rssBytes: after.rss - before.rss,
+    heapUsedBytes: after.heapUsed - before.heapUsed,
+    externalBytes: after.external - before.external,
+  };
+
+  results.construct = await measureWhole(() => {
+    make(pairs);
+  });
+  results.getHit = await measure(minOps, (i) => map.get(keys[i % size]));
+  results.getMiss = await measure(minOps, (i) => map.get(misses[i % size]));
+  results.has = await measure(minOps, (i) => map.has(keys[i % size]));
+  results.forOf = await measureWhole(() => {
+    for (const entry of map) {
+      if (entry === undefined) {
+        throw new Error('unreachable');
+      }
+    }
+  });
+  results.forEach = await measureWhole(() => {
+    map.forEach(() => {});
+  });
+
+  // reads and writes mixed, the writes overwriting keys that are there
+  // and adding back ones that were deleted
+  for (const reads of [90, 50]) {
+    results[`mixed${reads}`] = await measure(minOps, (i) => {
+      const key = keys[(i * 7919) % size];
+      if (i % 100 < reads) {
+        map.get(key);
+      } else if (i % 2) {
+        map.set(key, i);
+      } else {
+        map.delete(key);
+      }
+    });
+  }
+
+  map = make(pairs);
+  results.delete = await measure(size, (i) => {
+    if (i < size) {
+      map.delete(keys[i]);
+    }
+  });
+
+  observer.disconnect();
+  process.stdout.write(JSON.stringify({map: options.map, keys: options.keys, size, memory, ops: results}));
+}
+
+function format(number) {
+  return number >= 1e6 ? `${(number / 1e6).toFixed(2)}M` : number >= 1e3 ? `${(number / 1e3).toFixed(1)}k` : String(number);
+}
+
+function run(args) {
+  const sizes = list(args.sizes, ['1e3', '1e4', '1e5', '1e6']).map(Number);
+  const keys = list(args.keys, keyTypes);
+  const names = list(args.maps, Object.keys(maps));
+  const ops = Number(args.ops) || 1e5;
+  const out = args.out || path.join(__dirname, 'results', `${new Date().toISOString().replace(/[:.]/g, '-')}.json`);
+  const results = [];
+
+  for (const size of sizes) {
+    for (const keyType of keys) {
+      const baseline = {};
+      for (const name of names) {
+        if (!maps[name]) {
+          throw new Error(`Unknown map ${name}, one of ${Object.keys(maps).join(', ')}`);
+        }
+        if (maps[name].keys && !maps[name].keys.includes(keyType)) {
+          continue;
+        }
+        const options = {map: name, keys: keyType, size, ops};
+        const output = childProcess.execFileSync(process.execPath,
+          ['--expose-gc', __filename, '--case', JSON.stringify(options)],
+          {maxBuffer: 1 << 24, stdio: ['ignore', 'pipe', 'inherit']});
+        const result = JSON.parse(output);
+        results.push(result);
+
+        if (name === 'builtin') {
+          Object.assign(baseline, result.ops);
+        }
+        const summary = Object.keys(result.ops).map((op) => {
+          const relative = baseline[op] ? ` (${(result.ops[op].opsPerSec / baseline[op].opsPerSec).toFixed(2)}x)` : '';
+          return `${op} ${format(result.ops[op].opsPerSec)}/s${relative}`;
+        });
+        console.log(`${name} ${keyType} keys x${format(size)}: ${format(result.memory.rssBytes)}B rss, ${summary.join(', ')}`);
+      }
+    }
+  }
+
+  const report = {
+    date: new Date().toISOString(),
+    version: require('../package.json').version,
+    node: process.version,
+    v8: process.versions.v8,
+    platform: `${os.platform()} ${os.arch()}`,
+    cpu: os.cpus()[0] && os.cpus()[0].model,
+    results,
+  };
+  fs.mkdirSync(path.dirname(out), {recursive: true});
+  fs.writeFileSync(out, JSON.stringify(report, null, 2));
+  console.log(`wrote ${out}`);
+}
+
+// prints how every operation changed between two runs, and exits with 1 if
+// any got slower by more than the threshold
+function compare(args, files) {
+  const threshold = Number(args.threshold) || 0.1;
+  const [before, after] = files.map((file) => JSON.parse(fs.readFileSync(file, 'utf8')));
+  const index = {};
+  let regressions = 0;
+
+  before.results.forEach((result) => {
+    index[`${result.map} ${result.keys} ${result.size}`] = result;
+  });
+  after.results.forEach((result) => {
+    const old = index[`${result.map} ${result.keys} ${result.size}`];
+    if (!old) {
+      return;
+    }
+    Object.keys(result.ops).forEach((op) => {
+      if (!old.ops[op]) {
+        return;
+      }
+      const ratio = result.ops[op].opsPerSec / old.ops[op].opsPerSec;
+      const slower = ratio < 1 - threshold;
+      regressions += slower ? 1 : 0;
+      console.log(`${slower ? '!' : ' '} ${result.map} ${result.keys} x${format(result.size)} ${op}: ${ratio.toFixed(2)}x`);
+    });
+  });
+  process.exitCode = regressions ? 1 : 0;
+}
+
+const args = parseArgs(process.argv.slice(2));
+if (args.case) {
+  runCase(JSON.parse(args.case));
+} else if (args.compare) {
+  compare(args, [args.compare, args._[0]]);
+} else {
+  run(args);
+}
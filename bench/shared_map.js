@@ -0,0 +1,77 @@
+'use strict';
+
+// Read throughput of one SharedMap read from 1, 2, 4, ... worker threads
+// at once, up to the number of cores. With reads spread over the shard
+// locks, the total should grow close to linearly with the thread count.
+//
+//   node bench/shared_map.js [entries] [reads per thread]
+
+const os = require('os');
+const {Worker, isMainThread, parentPort, workerData} = require('worker_threads');
+const {SharedMap} = require('../index.js');
+
+if (!isMainThread) {
+  const map = new SharedMap(workerData.name);
+  const entries = workerData.entries;
+  let found = 0;
+
+  parentPort.once('message', () => {
+    const start = process.hrtime();
+    for (let i = 0; i < workerData.reads; i++) {
+      if (map.get(i % entries) !== undefined) {
+        found++;
+      }
+    }
+    const time = process.hrtime(start);
+    parentPort.postMessage({found, seconds: time[0] + time[1] / 1e9});
+  });
+  parentPort.postMessage('ready');
+  return;
+}
+
+const entries = parseInt(process.argv[2], 10) || 1000000;
+const reads = parseInt(process.argv[3], 10) || 2000000;
+const map = new SharedMap('bench');
+
+for (let i = 0; i < entries; i++) {
+  map.set(i, {id: i, name: 'entry ' + i});
+}
+
+function run(threads) {
+  return new Promise((resolve, reject) => {
+    const workers = [];
+    const results = [];
+    let ready = 0;
+
+    for (let i = 0; i < threads; i++) {
+      const worker = new Worker(__filename, {workerData: {name: 'bench', entries, reads}});
+      worker.on('error', reject);
+      worker.on('message', (message) => {
+        if (message === 'ready') {
+          // start every thread together once they are all loaded
+          if (++ready === threads) {
+            workers.forEach((w) => w.postMessage('go'));
+          }
+          return;
+        }
+        results.push(message);
+        worker.terminate();
+        if (results.length === threads) {
+          const slowest = Math.max.apply(null, results.map((r) => r.seconds));
+          resolve(threads * reads / slowest);
+        }
+      });
+      workers.push(worker);
+    }
+  });
+}
+
+(async () => {
+  console.log('SharedMap get, %d entries, %d reads per thread', entries, reads);
+  let single = 0;
+  for (let threads = 1; threads <= os.cpus().length; threads *= 2) {
+    const rate = await run(threads);
+    single = single || rate;
+    console.log('%d thread(s): %s reads/s (%sx)', threads, Math.round(rate).toLocaleString(), (rate / single).toFixed(2));
+  }
+})();
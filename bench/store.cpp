@@ -0,0 +1,233 @@
+// Compares FlatTable, NodeMap's store, against the std::unordered_set it
+// replaced, without V8: entries are laid out like the real ones, with two
+// 8 byte words standing in for the key and value handles, and a key is
+// compared by its word where the map would call StrictEquals. Both stores
+// hash with the same function, so the numbers are about the table alone.
+//
+//   g++ -std=c++11 -O2 -Isrc bench/store.cpp -o store && ./store [size...]
+//
+// For each size it prints the bytes malloc holds per entry, and the
+// average time of an insert, a lookup that hits and one that misses, over
+// keys looked up in a random order, one after the other. Memory is read from glibc's mallinfo2,
+// so it includes malloc's own overhead.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_set>
+#include <vector>
+#include "flat_table.h"
+
+// a VersionedPersistentPair from before FlatTable: the probe pointer and
+// deleted flag it needed to be looked up in and erased from the set
+struct OldEntry {
+    uint32_t version;
+    mutable bool deleted;
+    const void *view;
+    uint64_t key;
+    uint64_t value;
+};
+
+// a VersionedPersistentPair now: recency links and the hash, no flags
+struct NewEntry {
+    NewEntry() : version(0xffffffff), older(0), newer(0), hash(0), key(0), value(0) {}
+
+    bool IsHole() const {
+        return version == 0xffffffff;
+    }
+
+    void Release() {
+        version = 0xffffffff;
+    }
+
+    uint32_t version;
+    uint32_t older;
+    uint32_t newer;
+    uint32_t hash;
+    uint64_t key;
+    uint64_t value;
+};
+
+static uint32_t key_hash(uint64_t key) {
+    key ^= key >> 31;
+    key *= 0x9e3779b97f4a7c15ULL;
+    return static_cast<uint32_t>(key ^ (key >> 32));
+}
+
+struct OldHash {
+    size_t operator()(const OldEntry &entry) const {
+        return key_hash(entry.key);
+    }
+};
+
+struct OldEqual {
+    bool operator()(const OldEntry &a, const OldEntry &b) const {
+        return a.key == b.key;
+    }
+};
+
+struct NewHash {
+    size_t operator()(const NewEntry &entry) const {
+        return entry.hash;
+    }
+};
+
+struct NewMatch {
+    explicit NewMatch(uint64_t key) : _key(key) {}
+
+    bool operator()(const NewEntry &entry, uint32_t) const {
+        return entry.key == _key;
+    }
+
+    uint64_t _key;
+};
+
+typedef std::unordered_set<OldEntry, OldHash, OldEqual> OldStore;
+typedef FlatTable<NewEntry, NewHash> NewStore;
+
+// in use from the heap, plus blocks big enough that malloc mmapped them
+static size_t heap_bytes() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Result {
+    double bytes_per_entry;
+    double insert_ns;
+    double hit_ns;
+    double miss_ns;
+};
+
+// keeps lookups from being optimized away. zero is read through a
+// volatile, so the compiler can't tell that mixing a lookup's result into
+// the next key changes nothing: each lookup waits for the one before,
+// like lookups from JS do, instead of overlapping with it
+static volatile uint64_t sink;
+static volatile uint64_t volatile_zero;
+
+static Result run_old(const std::vector<uint64_t> &keys, const std::vector<uint64_t> &hits, const std::vector<uint64_t> &misses) {
+    Result result;
+    size_t before = heap_bytes();
+    OldStore *store = new OldStore();
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+        OldEntry entry = {1, false, NULL, keys[i], i};
+        store->insert(entry);
+    }
+    result.insert_ns = seconds_since(start) * 1e9 / keys.size();
+    result.bytes_per_entry = static_cast<double>(heap_bytes() - before) / keys.size();
+
+    uint64_t zero = volatile_zero;
+    uint64_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < hits.size(); i++) {
+        OldEntry probe = {0, false, NULL, hits[i] + (found & zero), 0};
+        OldStore::const_iterator it = store->find(probe);
+        found += it->value;
+    }
+    result.hit_ns = seconds_since(start) * 1e9 / hits.size();
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < misses.size(); i++) {
+        OldEntry probe = {0, false, NULL, misses[i] + (found & zero), 0};
+        found += store->find(probe) == store->end();
+    }
+    result.miss_ns = seconds_since(start) * 1e9 / misses.size();
+
+    sink = found;
+    delete store;
+    return result;
+}
+
+static Result run_new(const std::vector<uint64_t> &keys, const std::vector<uint64_t> &hits, const std::vector<uint64_t> &misses) {
+    Result result;
+    size_t before = heap_bytes();
+    NewStore *store = new NewStore();
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint32_t hash = key_hash(keys[i]);
+        NewStore::InsertHint hint;
+        if (store->FindOrPrepare(hash, NewMatch(keys[i]), &hint) == NewStore::npos) {
+            NewEntry &entry = store->At(store->Insert(hash, hint));
+            entry.version = 1;
+            entry.hash = hash;
+            entry.key = keys[i];
+            entry.value = i;
+        }
+    }
+    result.insert_ns = seconds_since(start) * 1e9 / keys.size();
+    result.bytes_per_entry = static_cast<double>(heap_bytes() - before) / keys.size();
+
+    uint64_t zero = volatile_zero;
+    uint64_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < hits.size(); i++) {
+        uint64_t key = hits[i] + (found & zero);
+        found += store->At(store->Find(key_hash(key), NewMatch(key))).value;
+    }
+    result.hit_ns = seconds_since(start) * 1e9 / hits.size();
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < misses.size(); i++) {
+        uint64_t key = misses[i] + (found & zero);
+        found += store->Find(key_hash(key), NewMatch(key)) == NewStore::npos;
+    }
+    result.miss_ns = seconds_since(start) * 1e9 / misses.size();
+
+    sink = found;
+    delete store;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(static_cast<size_t>(atof(argv[i])));
+    }
+    if (sizes.empty()) {
+        sizes.push_back(1000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+        sizes.push_back(10000000);
+    }
+
+    printf("%10s  %-14s %12s %10s %10s %10s\n", "size", "store", "bytes/entry", "insert ns", "hit ns", "miss ns");
+    for (size_t s = 0; s < sizes.size(); s++) {
+        size_t size = sizes[s];
+        std::mt19937_64 random(size);
+        std::vector<uint64_t> keys(size);
+        std::vector<uint64_t> misses(size);
+        for (size_t i = 0; i < size; i++) {
+            // even keys are set, odd ones never are
+            keys[i] = random() & ~static_cast<uint64_t>(1);
+            misses[i] = keys[i] | 1;
+        }
+        // enough lookups to time, even for the small sizes
+        std::vector<uint64_t> hits;
+        std::vector<uint64_t> unset;
+        while (hits.size() < std::max<size_t>(size, 1000000)) {
+            hits.insert(hits.end(), keys.begin(), keys.end());
+            unset.insert(unset.end(), misses.begin(), misses.end());
+        }
+        std::shuffle(hits.begin(), hits.end(), random);
+        misses.swap(unset);
+
+        Result old_result = run_old(keys, hits, misses);
+        Result new_result = run_new(keys, hits, misses);
+        printf("%10zu  %-14s %12.1f %10.1f %10.1f %10.1f\n", size, "unordered_set",
+            old_result.bytes_per_entry, old_result.insert_ns, old_result.hit_ns, old_result.miss_ns);
+        printf("%10zu  %-14s %12.1f %10.1f %10.1f %10.1f\n", size, "FlatTable",
+            new_result.bytes_per_entry, new_result.insert_ns, new_result.hit_ns, new_result.miss_ns);
+    }
+    return 0;
+}
@@ -1,7 +1,7 @@
 {
     "targets": [{
         "target_name": "native",
-        "sources": [ "src/map.cpp", "src/iterator.cpp" ],
+        "sources": [ "src/map.cpp", "src/iterator.cpp", "src/iterable_map.cpp", "src/primitive_map.cpp", "src/set.cpp", "src/array_store.cpp", "src/serialized_store.cpp", "src/shared_map.cpp", "src/shared_key.cpp", "src/snapshot.cpp", "src/timer_wheel.cpp", "src/wtf8.cpp" ],
         "include_dirs" : [ "<!(node -e \"require('nan')\")" ],
         "cflags": ["-std=c++11", "-Wall"],
         "conditions": [
@@ -1 +1,8 @@
-module.exports = require('./build/Release/native').NodeMap;
+const native = require('./build/Release/native');
+
+module.exports = native.NodeMap;
+module.exports.NumberMap = native.NumberMap;
+module.exports.StringMap = native.StringMap;
+module.exports.NodeSet = native.NodeSet;
+module.exports.SharedMap = native.SharedMap;
+module.exports.SnapshotMap = native.SnapshotMap;
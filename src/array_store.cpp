@@ -0,0 +1,118 @@
+#include "array_store.h"
+
+using namespace v8;
+
+ArrayStore::ArrayStore() {
+    this->_chunks.Reset(Nan::New<Array>());
+}
+
+ArrayStore::~ArrayStore() {
+    this->_chunks.Reset();
+}
+
+Local<Array> ArrayStore::Chunk(uint32_t pos, bool make) {
+    Local<Array> chunks = Nan::New(this->_chunks);
+    uint32_t index = pos >> kChunkBits;
+
+    while (make && chunks->Length() <= index) {
+        Nan::Set(chunks, chunks->Length(), Nan::New<Array>(kMinChunkLength));
+    }
+    if (index >= chunks->Length()) {
+        return Local<Array>();
+    }
+
+    Local<Array> chunk = Nan::Get(chunks, index).ToLocalChecked().As<Array>();
+    uint32_t needed = ((pos & (kChunkSize - 1)) + 1) * 2;
+    if (make && chunk->Length() < needed) {
+        chunk = this->GrowChunk(chunks, index, needed);
+    }
+    return chunk;
+}
+
+// copied into a new array made at its full length, rather than set past
+// the end, which could leave V8 with a sparse dictionary array
+Local<Array> ArrayStore::GrowChunk(Local<Array> chunks, uint32_t index, uint32_t needed) {
+    Local<Array> chunk = Nan::Get(chunks, index).ToLocalChecked().As<Array>();
+    uint32_t length = chunk->Length();
+    uint32_t grown = length < kMinChunkLength ? kMinChunkLength : length;
+
+    while (grown < needed) {
+        grown *= 2;
+    }
+    if (grown > kChunkSize * 2) {
+        grown = kChunkSize * 2;
+    }
+
+    Local<Array> bigger = Nan::New<Array>(grown);
+    for (uint32_t i = 0; i < length; i++) {
+        Nan::Set(bigger, i, Nan::Get(chunk, i).ToLocalChecked());
+    }
+    Nan::Set(chunks, index, bigger);
+    return bigger;
+}
+
+Local<Value> ArrayStore::GetKey(uint32_t pos) {
+    Local<Array> chunk = this->Chunk(pos, false);
+    if (chunk.IsEmpty()) {
+        return Nan::Undefined();
+    }
+    return Nan::Get(chunk, (pos & (kChunkSize - 1)) * 2).ToLocalChecked();
+}
+
+Local<Value> ArrayStore::GetValue(uint32_t pos) {
+    Local<Array> chunk = this->Chunk(pos, false);
+    if (chunk.IsEmpty()) {
+        return Nan::Undefined();
+    }
+    return Nan::Get(chunk, (pos & (kChunkSize - 1)) * 2 + 1).ToLocalChecked();
+}
+
+// an empty value is kept as undefined, for maps whose values are elsewhere
+void ArrayStore::Set(uint32_t pos, Local<Value> key, Local<Value> value) {
+    Local<Array> chunk = this->Chunk(pos, true);
+    uint32_t index = (pos & (kChunkSize - 1)) * 2;
+
+    if (value.IsEmpty()) {
+        value = Nan::Undefined();
+    }
+    Nan::Set(chunk, index, key);
+    Nan::Set(chunk, index + 1, value);
+}
+
+void ArrayStore::SetValue(uint32_t pos, Local<Value> value) {
+    if (value.IsEmpty()) {
+        value = Nan::Undefined();
+    }
+    Nan::Set(this->Chunk(pos, true), (pos & (kChunkSize - 1)) * 2 + 1, value);
+}
+
+void ArrayStore::Release(uint32_t pos) {
+    Local<Array> chunk = this->Chunk(pos, false);
+    if (chunk.IsEmpty()) {
+        return;
+    }
+    uint32_t index = (pos & (kChunkSize - 1)) * 2;
+
+    Nan::Set(chunk, index, Nan::Undefined());
+    Nan::Set(chunk, index + 1, Nan::Undefined());
+}
+
+void ArrayStore::Move(uint32_t to, uint32_t from) {
+    Nan::HandleScope scope;
+
+    this->Set(to, this->GetKey(from), this->GetValue(from));
+    this->Release(from);
+}
+
+void ArrayStore::Truncate(uint32_t end) {
+    Local<Array> chunks = Nan::New(this->_chunks);
+    uint32_t count = (end + kChunkSize - 1) >> kChunkBits;
+
+    if (chunks->Length() > count) {
+        Nan::Set(chunks, Nan::New("length").ToLocalChecked(), Nan::New<Integer>(count));
+    }
+}
+
+void ArrayStore::Clear() {
+    this->_chunks.Reset(Nan::New<Array>());
+}
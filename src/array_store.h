@@ -0,0 +1,63 @@
+#ifndef ARRAY_STORE_H
+#define ARRAY_STORE_H
+
+#include <node.h>
+#include <nan.h>
+#include "v8_value_hasher.h"
+
+// keys and values kept in plain JS arrays instead of a pair of global
+// handles per entry. Positions are split into chunks of kChunkSize, each
+// chunk an array of [key, value, key, value, ...], and the chunks are
+// held in one more array, so the whole store is a single global handle
+// and its contents are ordinary heap objects as far as the GC goes. A
+// chunk starts small and doubles as positions in it are set, so a small
+// map doesn't hold a whole chunk
+class ArrayStore {
+public:
+    ArrayStore();
+    ~ArrayStore();
+
+    v8::Local<v8::Value> GetKey(uint32_t pos);
+    v8::Local<v8::Value> GetValue(uint32_t pos);
+
+    void Set(uint32_t pos, v8::Local<v8::Value> key, v8::Local<v8::Value> value);
+    void SetValue(uint32_t pos, v8::Local<v8::Value> value);
+
+    // drops the key and value at pos, so they can be collected
+    void Release(uint32_t pos);
+    // puts the key and value at from into to, and releases from
+    void Move(uint32_t to, uint32_t from);
+    // drops the chunks that are entirely at or past end
+    void Truncate(uint32_t end);
+    void Clear();
+
+private:
+    static const uint32_t kChunkBits = 15;
+    static const uint32_t kChunkSize = 1 << kChunkBits;
+    // the length a chunk starts with, room for 8 keys and values
+    static const uint32_t kMinChunkLength = 16;
+
+    // the chunk pos is in, made or grown to hold pos on the way if make is
+    // set. An empty handle if it isn't there
+    v8::Local<v8::Array> Chunk(uint32_t pos, bool make);
+    // replaces the chunk at index with a copy of it at least needed long
+    v8::Local<v8::Array> GrowChunk(v8::Local<v8::Array> chunks, uint32_t index, uint32_t needed);
+
+    Nan::Persistent<v8::Array> _chunks;
+};
+
+// matches entries of a map whose keys are in an ArrayStore against the
+// key being looked up
+struct array_store_equal_to
+{
+    array_store_equal_to(const KeyView &key, ArrayStore *store) : _key(key), _store(store) {}
+
+    bool operator()(const VersionedPersistentPair &entry, uint32_t pos) const {
+        return entry.GetHash() == _key.GetHash() && _key.Matches(_store->GetKey(pos));
+    }
+
+    const KeyView &_key;
+    ArrayStore *_store;
+};
+
+#endif
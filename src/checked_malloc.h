@@ -0,0 +1,20 @@
+#ifndef CHECKED_MALLOC_H
+#define CHECKED_MALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// malloc for the native blocks behind the tables. The addon is built
+// without exceptions, so there's nothing to unwind to when one can't be
+// had, and the process goes down the way it would if a std container
+// couldn't grow
+inline void *checked_malloc(size_t bytes) {
+    void *block = malloc(bytes);
+    if (block == NULL && bytes != 0) {
+        fprintf(stderr, "es6-native-map: out of memory allocating %lu bytes\n", static_cast<unsigned long>(bytes));
+        abort();
+    }
+    return block;
+}
+
+#endif
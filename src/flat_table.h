@@ -0,0 +1,841 @@
+#ifndef FLAT_TABLE_H
+#define FLAT_TABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "checked_malloc.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_TABLE_SSE2 1
+#endif
+
+// An open addressing hash index over a dense array of entries.
+//
+// Entries are kept in _entries and never move once created, so a position
+// into it is a stable handle that iterators can hold on to across inserts,
+// deletes and index rebuilds. The index is swiss table style: one control
+// byte per slot (empty, deleted, or the low 7 bits of the hash) and a
+// parallel array of 32 bit positions into _entries. A probe looks at 16
+// control bytes at a time and only touches an entry when its hash fragment
+// matches.
+//
+// An Entry is default constructible as a hole, and has to provide
+//   bool IsHole() const;   // true for a default constructed entry
+//   void Release();        // drops the contents, making it a hole again
+// Hasher(entry) has to return the same hash the entry was inserted with.
+// Compact() also needs
+//   void MoveFrom(Entry &other);   // takes other over, leaving it a hole
+//
+// In ordered mode holes are never handed out again, so entries sit in
+// _entries in the order they were inserted, until Compact() slides them
+// down over the holes.
+//
+// Big indexes are rebuilt incrementally: the new index is allocated, and
+// every insert and erase moves the next kMigrateStep positions over from
+// the old one, so no single call pays for the whole table. While that is
+// going on an entry is in the new index if its position has been moved
+// already or was appended after the rebuild started, and in the old one
+// otherwise. Free positions aren't handed out again until it's done, so
+// that rule holds.
+// what FlatTable::GetStats reports, for seeing why a table is slow
+struct FlatTableStats {
+    // slots in the index, and the ones marked deleted
+    size_t capacity;
+    size_t deleted;
+    // positions in the dense array that aren't in use
+    size_t holes;
+    // groups a lookup of a live key looks at, the most and on average
+    size_t max_probe;
+    double average_probe;
+    // times the index was built again, and whether it's being moved over
+    // to a new one right now
+    size_t rehashes;
+    bool migrating;
+    // memory held by the index, the old index and the entries
+    size_t bytes;
+};
+
+template <typename Entry, typename Hasher>
+class FlatTable {
+public:
+    static const uint32_t npos = 0xffffffff;
+
+    // where FindOrPrepare saw room for a key it didn't find, so inserting
+    // it doesn't have to probe again. Erasing entries leaves it good, but
+    // not rebuilding or clearing the index
+    struct InsertHint {
+        InsertHint() : slot(kNoSlot), step(0), rehashes(0) {}
+
+        size_t slot;
+        size_t step;
+        size_t rehashes;
+    };
+
+    FlatTable()
+        : _ctrl(NULL), _slots(NULL), _capacity(0)
+        , _old_ctrl(NULL), _old_slots(NULL), _old_capacity(0), _migrated(0), _migrate_end(0)
+        , _size(0), _deleted(0), _growth_left(0), _rehashes(0), _ordered(false)
+        , _flooded(false), _reseed_capacity(0), _reseeds(0), _inserts_since_reseed(0) {}
+
+    ~FlatTable() {
+        free(this->_ctrl);
+        free(this->_old_ctrl);
+    }
+
+    // number of live entries
+    size_t Size() const {
+        return this->_size;
+    }
+
+    // one past the last position in use, holes included
+    uint32_t End() const {
+        return static_cast<uint32_t>(this->_entries.size());
+    }
+
+    size_t Capacity() const {
+        return this->_capacity;
+    }
+
+    Entry &At(uint32_t pos) {
+        return this->_entries[pos];
+    }
+
+    const Entry &At(uint32_t pos) const {
+        return this->_entries[pos];
+    }
+
+    // switches to ordered mode, only while the table is empty
+    void SetOrdered() {
+        this->_ordered = true;
+    }
+
+    bool IsOrdered() const {
+        return this->_ordered;
+    }
+
+    // an ordered table is worth compacting once holes outnumber entries
+    bool NeedsCompaction() const {
+        uint32_t holes = this->End() - static_cast<uint32_t>(this->_size);
+        return this->_ordered && holes >= kGroupWidth && holes > this->_size;
+    }
+
+    // walks the whole index to measure probe lengths, so it costs about as
+    // much as a rehash
+    void GetStats(FlatTableStats *stats) const {
+        size_t probes = 0;
+        size_t keys = 0;
+
+        stats->max_probe = 0;
+        this->ProbeStats(this->_ctrl, this->_slots, this->_capacity, &probes, &keys, &stats->max_probe);
+        this->ProbeStats(this->_old_ctrl, this->_old_slots, this->_old_capacity, &probes, &keys, &stats->max_probe);
+
+        stats->capacity = this->_capacity;
+        stats->deleted = this->_deleted;
+        stats->holes = this->End() - this->_size;
+        stats->average_probe = keys == 0 ? 0 : static_cast<double>(probes) / keys;
+        stats->rehashes = this->_rehashes;
+        stats->migrating = this->_old_ctrl != NULL;
+        stats->bytes = this->Bytes();
+    }
+
+    // memory held by the index, the old index and the entries, without
+    // walking anything
+    size_t Bytes() const {
+        return (this->_capacity + this->_old_capacity) * (sizeof(uint8_t) + sizeof(uint32_t))
+            + this->_entries.size() * sizeof(Entry)
+            + this->_free.capacity() * sizeof(uint32_t);
+    }
+
+    // whether a key had to be placed kFloodProbe groups or more from where
+    // its probe sequence starts. With a seeded hash that only happens to
+    // keys picked to collide, so the owner should give every entry a hash
+    // with a new seed and Reseed. After a reseed it's only reported again
+    // once the index has grown or taken as many inserts as there are
+    // entries, so however the keys collide reseeding costs O(1) per insert
+    bool Flooded() const {
+        return this->_flooded
+            && (this->_capacity > this->_reseed_capacity || this->_inserts_since_reseed >= this->_size);
+    }
+
+    // times Reseed has run. An owner flooded again after one should move
+    // to a stronger hash rather than just another seed
+    size_t Reseeds() const {
+        return this->_reseeds;
+    }
+
+    // gives every live entry a new hash with rehash(entry, pos), and
+    // rebuilds the index for them. Positions don't change
+    template <typename Rehasher>
+    void Reseed(const Rehasher &rehash) {
+        this->FinishMigration();
+        uint32_t end = this->End();
+        for (uint32_t pos = 0; pos < end; pos++) {
+            if (!this->_entries[pos].IsHole()) {
+                rehash(this->_entries[pos], pos);
+            }
+        }
+        this->_reseed_capacity = this->_capacity;
+        this->_reseeds++;
+        this->_inserts_since_reseed = 0;
+        this->Rehash(this->_capacity);
+    }
+
+    // returns the position of the entry that matches(entry, pos) says is
+    // the one being looked for, or npos
+    template <typename Matcher>
+    uint32_t Find(size_t hash, const Matcher &matches) const {
+        if (this->_capacity == 0) {
+            return npos;
+        }
+
+        uint64_t mixed = Mix(hash);
+        uint32_t pos = this->FindIn(this->_ctrl, this->_slots, this->_capacity, mixed, matches);
+
+        if (pos == npos && this->_old_ctrl != NULL) {
+            pos = this->FindIn(this->_old_ctrl, this->_old_slots, this->_old_capacity, mixed, matches);
+        }
+        return pos;
+    }
+
+    // Find, that also fills in hint with where the key would go if it
+    // isn't there. There's no hint while the index is being migrated or
+    // when the next insert grows it
+    template <typename Matcher>
+    uint32_t FindOrPrepare(size_t hash, const Matcher &matches, InsertHint *hint) const {
+        hint->slot = kNoSlot;
+        hint->rehashes = this->_rehashes;
+        if (this->_old_ctrl != NULL || this->_growth_left == 0) {
+            return this->Find(hash, matches);
+        }
+
+        uint64_t mixed = Mix(hash);
+        uint8_t fragment = mixed & 0x7f;
+        size_t mask = (this->_capacity / kGroupWidth) - 1;
+        size_t group = (mixed >> 7) & mask;
+
+        for (size_t step = 1; step <= mask + 1; step++) {
+            size_t base = group * kGroupWidth;
+            Group g(this->_ctrl + base);
+
+            for (uint32_t bits = g.Match(fragment); bits != 0; bits &= bits - 1) {
+                uint32_t pos = this->_slots[base + LowestBit(bits)];
+                if (!this->_entries[pos].IsHole() && matches(this->_entries[pos], pos)) {
+                    hint->slot = kNoSlot;
+                    return pos;
+                }
+            }
+            // the same slot Place would pick
+            if (hint->slot == kNoSlot) {
+                uint32_t bits = g.MatchEmptyOrDeleted();
+                if (bits != 0) {
+                    hint->slot = base + LowestBit(bits);
+                    hint->step = step;
+                }
+            }
+            if (g.MatchEmpty() != 0) {
+                return npos;
+            }
+            group = (group + step) & mask;
+        }
+        return npos;
+    }
+
+    // adds an entry for a key that is known not to be in the table yet and
+    // returns its position, the entry there is a hole for the caller to fill
+    uint32_t Insert(size_t hash) {
+        if (this->_old_ctrl != NULL) {
+            this->MigrateStep();
+        }
+        if (this->_growth_left == 0) {
+            this->Grow();
+        }
+
+        uint32_t pos = this->NewPosition();
+        this->Place(Mix(hash), pos);
+        this->_size++;
+        this->_inserts_since_reseed++;
+        return pos;
+    }
+
+    // Insert into the slot FindOrPrepare found, if the hint is still good
+    uint32_t Insert(size_t hash, const InsertHint &hint) {
+        if (hint.slot == kNoSlot || hint.rehashes != this->_rehashes) {
+            return this->Insert(hash);
+        }
+
+        uint32_t pos = this->NewPosition();
+        this->Fill(hint.slot, Mix(hash), pos, hint.step);
+        this->_size++;
+        this->_inserts_since_reseed++;
+        return pos;
+    }
+
+    // removes the entry at pos, hash is the one it was inserted with
+    void Erase(uint32_t pos, size_t hash) {
+        if (!this->InNewIndex(pos)) {
+            // the old index only has to stay good for lookups until it is
+            // dropped, so there's no bookkeeping to do
+            size_t slot = SlotOf(this->_old_ctrl, this->_old_slots, this->_old_capacity, pos, hash);
+            if (slot != kNoSlot) {
+                this->_old_ctrl[slot] = kDeleted;
+            }
+            this->_entries[pos].Release();
+            if (!this->_ordered) {
+                this->_free.push_back(pos);
+            }
+            this->_size--;
+            this->MigrateStep();
+            return;
+        }
+
+        size_t slot = SlotOf(this->_ctrl, this->_slots, this->_capacity, pos, hash);
+        size_t base = slot & ~(kGroupWidth - 1);
+
+        // a probe only moves past a group when it is full, so if this
+        // group still has an empty slot no probe sequence can run through
+        // it, and the slot can go straight back to empty
+        if (slot == kNoSlot) {
+            // not indexed, only the entry has to go
+        } else if (Group(this->_ctrl + base).MatchEmpty() != 0) {
+            this->_ctrl[slot] = kEmpty;
+            this->_growth_left++;
+        } else {
+            this->_ctrl[slot] = kDeleted;
+            this->_deleted++;
+        }
+
+        this->_entries[pos].Release();
+        if (!this->_ordered) {
+            this->_free.push_back(pos);
+        }
+        this->_size--;
+
+        if (this->_old_ctrl != NULL) {
+            this->MigrateStep();
+        }
+    }
+
+    // sizes the index so that count entries fit without another rebuild
+    void Reserve(size_t count) {
+        this->FinishMigration();
+        size_t capacity = this->_capacity == 0 ? kGroupWidth : this->_capacity;
+        while (MaxLoad(capacity) < count) {
+            capacity *= 2;
+        }
+        if (capacity > this->_capacity) {
+            this->Rehash(capacity);
+        }
+    }
+
+    // gives the index the smallest capacity that holds the live entries,
+    // and drops the holes at the end of the dense array. Holes before the
+    // last live entry stay, since positions can't change under iterators
+    void ShrinkToFit() {
+        this->FinishMigration();
+        uint32_t end = this->End();
+        while (end > 0 && this->_entries[end - 1].IsHole()) {
+            end--;
+        }
+        if (end < this->End()) {
+            // the deque hands its blocks back as it is popped
+            while (this->End() > end) {
+                this->_entries.pop_back();
+            }
+            std::vector<uint32_t> kept;
+            for (size_t i = 0; i < this->_free.size(); i++) {
+                if (this->_free[i] < end) {
+                    kept.push_back(this->_free[i]);
+                }
+            }
+            this->_free.swap(kept);
+        }
+        this->_free.shrink_to_fit();
+
+        if (this->_size == 0) {
+            free(this->_ctrl);
+            this->_ctrl = NULL;
+            this->_slots = NULL;
+            this->_capacity = 0;
+            this->_deleted = 0;
+            this->_growth_left = 0;
+            this->_flooded = false;
+            return;
+        }
+
+        size_t capacity = kGroupWidth;
+        while (MaxLoad(capacity) < this->_size) {
+            capacity *= 2;
+        }
+        if (capacity != this->_capacity || this->_deleted != 0) {
+            this->Rehash(capacity);
+        }
+    }
+
+    // slides every entry down over the holes before it, keeping their
+    // order, and rebuilds the index. Positions change, so nothing may be
+    // holding on to one; moved(to, from) is told about each entry that
+    // moves
+    template <typename Mover>
+    void Compact(const Mover &moved) {
+        uint32_t end = this->End();
+        uint32_t to = 0;
+
+        for (uint32_t from = 0; from < end; from++) {
+            if (!this->_entries[from].IsHole()) {
+                if (to != from) {
+                    this->_entries[to].MoveFrom(this->_entries[from]);
+                    moved(to, from);
+                }
+                to++;
+            }
+        }
+        while (this->End() > to) {
+            this->_entries.pop_back();
+        }
+        this->_free.clear();
+
+        free(this->_old_ctrl);
+        this->_old_ctrl = NULL;
+        this->_old_slots = NULL;
+        this->_old_capacity = 0;
+        if (this->_capacity != 0) {
+            this->Rehash(this->_capacity);
+        }
+    }
+
+    // makes this empty table a copy of other. The index is copied as it
+    // is instead of being rebuilt, and copy(to, from, pos) fills in each
+    // live entry at the same position it has in other
+    template <typename Copier>
+    void CopyFrom(const FlatTable &other, const Copier &copy) {
+        this->FinishMigration();
+
+        // an index halfway through a rebuild can't be copied as it is
+        if (other._old_ctrl != NULL) {
+            this->CopyEntriesFrom(other, copy);
+            this->Rehash(other._capacity);
+            return;
+        }
+
+        uint8_t *ctrl = NULL;
+        if (other._capacity != 0) {
+            size_t bytes = other._capacity * (sizeof(uint8_t) + sizeof(uint32_t));
+            ctrl = static_cast<uint8_t *>(checked_malloc(bytes));
+            memcpy(ctrl, other._ctrl, bytes);
+        }
+        free(this->_ctrl);
+
+        this->_ctrl = ctrl;
+        this->_slots = ctrl == NULL ? NULL : reinterpret_cast<uint32_t *>(ctrl + other._capacity);
+        this->_capacity = other._capacity;
+        this->_deleted = other._deleted;
+        this->_growth_left = other._growth_left;
+        this->_flooded = other._flooded;
+        this->_reseed_capacity = other._reseed_capacity;
+        this->_reseeds = other._reseeds;
+        this->_inserts_since_reseed = other._inserts_since_reseed;
+        this->CopyEntriesFrom(other, copy);
+    }
+
+    void Clear() {
+        free(this->_old_ctrl);
+        this->_old_ctrl = NULL;
+        this->_old_slots = NULL;
+        this->_old_capacity = 0;
+        this->_entries.clear();
+        this->_free.clear();
+        this->_size = 0;
+        this->_deleted = 0;
+        this->_flooded = false;
+        if (this->_capacity != 0) {
+            memset(this->_ctrl, kEmpty, this->_capacity);
+            this->_growth_left = MaxLoad(this->_capacity);
+        }
+    }
+
+private:
+    static const size_t kGroupWidth = 16;
+    // indexes at least this big are rebuilt incrementally
+    static const size_t kMigrateMin = 4096;
+    // positions moved to the new index per insert or erase
+    static const uint32_t kMigrateStep = 128;
+    static const uint8_t kEmpty = 0x80;
+    static const uint8_t kDeleted = 0xfe;
+    // probe length, in groups, that counts as a flood. Random hashes at
+    // 7/8 load get to around 20 in a table of millions
+    static const size_t kFloodProbe = 64;
+    static const size_t kNoSlot = ~static_cast<size_t>(0);
+
+    // 16 control bytes, with bitmasks of the ones that match
+    class Group {
+    public:
+        explicit Group(const uint8_t *ctrl) {
+#ifdef FLAT_TABLE_SSE2
+            _ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+            memcpy(_ctrl, ctrl, kGroupWidth);
+#endif
+        }
+
+        uint32_t Match(uint8_t fragment) const {
+#ifdef FLAT_TABLE_SSE2
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_ctrl, _mm_set1_epi8(static_cast<char>(fragment))));
+#else
+            return this->MatchByte(fragment);
+#endif
+        }
+
+        uint32_t MatchEmpty() const {
+#ifdef FLAT_TABLE_SSE2
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_ctrl, _mm_set1_epi8(static_cast<char>(kEmpty))));
+#else
+            return this->MatchByte(kEmpty);
+#endif
+        }
+
+        // empty and deleted are the only control bytes with the high bit set
+        uint32_t MatchEmptyOrDeleted() const {
+#ifdef FLAT_TABLE_SSE2
+            return _mm_movemask_epi8(_ctrl);
+#else
+            uint32_t bits = 0;
+            for (size_t i = 0; i < kGroupWidth; i++) {
+                if (_ctrl[i] & 0x80) {
+                    bits |= 1u << i;
+                }
+            }
+            return bits;
+#endif
+        }
+
+    private:
+#ifdef FLAT_TABLE_SSE2
+        __m128i _ctrl;
+#else
+        uint32_t MatchByte(uint8_t byte) const {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < kGroupWidth; i++) {
+                if (_ctrl[i] == byte) {
+                    bits |= 1u << i;
+                }
+            }
+            return bits;
+        }
+
+        uint8_t _ctrl[kGroupWidth];
+#endif
+    };
+
+    static uint32_t LowestBit(uint32_t bits) {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        uint32_t i = 0;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            i++;
+        }
+        return i;
+#endif
+    }
+
+    // hashes coming in can be weak (small identity hashes, raw bits of a
+    // double), so spread them before splitting off the control fragment
+    static uint64_t Mix(size_t hash) {
+        uint64_t h = hash;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // slots that can be full before the index has to be rebuilt (7/8)
+    static size_t MaxLoad(size_t capacity) {
+        return capacity - capacity / 8;
+    }
+
+    // the old index still points at the positions already moved over,
+    // and at the holes they leave when they're erased from the new one,
+    // so a probe of it skips those. Matchers are never shown a hole
+    template <typename Matcher>
+    uint32_t FindIn(const uint8_t *ctrl, const uint32_t *slots, size_t capacity, uint64_t mixed, const Matcher &matches) const {
+        uint8_t fragment = mixed & 0x7f;
+        size_t mask = (capacity / kGroupWidth) - 1;
+        size_t group = (mixed >> 7) & mask;
+        bool old = ctrl == this->_old_ctrl;
+
+        for (size_t step = 1; step <= mask + 1; step++) {
+            size_t base = group * kGroupWidth;
+            Group g(ctrl + base);
+
+            for (uint32_t bits = g.Match(fragment); bits != 0; bits &= bits - 1) {
+                uint32_t pos = slots[base + LowestBit(bits)];
+                if (old && this->InNewIndex(pos)) {
+                    continue;
+                }
+                if (!this->_entries[pos].IsHole() && matches(this->_entries[pos], pos)) {
+                    return pos;
+                }
+            }
+            if (g.MatchEmpty() != 0) {
+                return npos;
+            }
+            group = (group + step) & mask;
+        }
+        return npos;
+    }
+
+    // puts pos in the first empty or deleted slot of its probe sequence
+    void Place(uint64_t mixed, uint32_t pos) {
+        size_t mask = (this->_capacity / kGroupWidth) - 1;
+        size_t group = (mixed >> 7) & mask;
+
+        for (size_t step = 1; ; step++) {
+            size_t base = group * kGroupWidth;
+            uint32_t bits = Group(this->_ctrl + base).MatchEmptyOrDeleted();
+            if (bits != 0) {
+                this->Fill(base + LowestBit(bits), mixed, pos, step);
+                return;
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    // points an empty or deleted slot, step groups into its probe
+    // sequence, at pos
+    void Fill(size_t slot, uint64_t mixed, uint32_t pos, size_t step) {
+        if (this->_ctrl[slot] == kEmpty) {
+            this->_growth_left--;
+        } else {
+            this->_deleted--;
+        }
+        this->_ctrl[slot] = mixed & 0x7f;
+        this->_slots[slot] = pos;
+        if (step >= kFloodProbe) {
+            this->_flooded = true;
+        }
+    }
+
+    // a hole to put a new entry in, reusing a free one unless the index is
+    // being migrated
+    uint32_t NewPosition() {
+        if (this->_old_ctrl == NULL && !this->_free.empty()) {
+            uint32_t pos = this->_free.back();
+            this->_free.pop_back();
+            return pos;
+        }
+        this->_entries.emplace_back();
+        return static_cast<uint32_t>(this->_entries.size() - 1);
+    }
+
+    // adds up how many groups each full slot of an index is from where its
+    // probe sequence starts
+    void ProbeStats(const uint8_t *ctrl, const uint32_t *slots, size_t capacity, size_t *probes, size_t *keys, size_t *max_probe) const {
+        Hasher hasher;
+        size_t mask = (capacity / kGroupWidth) - 1;
+
+        for (size_t slot = 0; slot < capacity; slot++) {
+            // the old index still has the positions already moved over
+            if ((ctrl[slot] & 0x80) || (ctrl == this->_old_ctrl && this->InNewIndex(slots[slot]))) {
+                continue;
+            }
+            size_t group = (Mix(hasher(this->_entries[slots[slot]])) >> 7) & mask;
+            size_t length = 1;
+            for (size_t step = 1; group != slot / kGroupWidth && step <= mask + 1; step++) {
+                group = (group + step) & mask;
+                length++;
+            }
+            *probes += length;
+            (*keys)++;
+            if (length > *max_probe) {
+                *max_probe = length;
+            }
+        }
+    }
+
+    bool InNewIndex(uint32_t pos) const {
+        return this->_old_ctrl == NULL || pos < this->_migrated || pos >= this->_migrate_end;
+    }
+
+    // the slot of the given index that points at pos, or kNoSlot once the
+    // probe has been through every group without finding it
+    static size_t SlotOf(const uint8_t *ctrl, const uint32_t *slots, size_t capacity, uint32_t pos, size_t hash) {
+        uint64_t mixed = Mix(hash);
+        uint8_t fragment = mixed & 0x7f;
+        size_t mask = (capacity / kGroupWidth) - 1;
+        size_t group = (mixed >> 7) & mask;
+
+        for (size_t step = 1; step <= mask + 1; step++) {
+            size_t base = group * kGroupWidth;
+            Group g(ctrl + base);
+            for (uint32_t bits = g.Match(fragment); bits != 0; bits &= bits - 1) {
+                size_t slot = base + LowestBit(bits);
+                if (slots[slot] == pos) {
+                    return slot;
+                }
+            }
+            if (g.MatchEmpty() != 0) {
+                return kNoSlot;
+            }
+            group = (group + step) & mask;
+        }
+        return kNoSlot;
+    }
+
+    // called when there are no empty slots left to fill: if at least half
+    // of the used slots are tombstones the index is rebuilt at the same
+    // size to get rid of them, otherwise it doubles
+    void Grow() {
+        size_t capacity;
+        if (this->_capacity == 0) {
+            capacity = kGroupWidth;
+        } else if (this->_size * 2 <= MaxLoad(this->_capacity)) {
+            capacity = this->_capacity;
+        } else {
+            capacity = this->_capacity * 2;
+        }
+
+        if (this->_capacity < kMigrateMin) {
+            this->Rehash(capacity);
+            return;
+        }
+
+        // the new index has to take every live entry, plus whatever gets
+        // inserted before the migration is done, without filling up
+        uint32_t end = this->End();
+        while (MaxLoad(capacity) < this->_size + end / kMigrateStep + kGroupWidth) {
+            capacity *= 2;
+        }
+
+        this->_old_ctrl = this->_ctrl;
+        this->_old_slots = this->_slots;
+        this->_old_capacity = this->_capacity;
+        this->_ctrl = NULL;
+        this->_migrated = 0;
+        this->_migrate_end = end;
+        this->AllocateIndex(capacity);
+        this->_rehashes++;
+        this->MigrateStep();
+    }
+
+    // moves the next kMigrateStep positions to the new index, and drops
+    // the old one once every position has been moved
+    void MigrateStep() {
+        Hasher hasher;
+        uint32_t stop = this->_migrate_end - this->_migrated > kMigrateStep ? this->_migrated + kMigrateStep : this->_migrate_end;
+
+        for (uint32_t pos = this->_migrated; pos < stop; pos++) {
+            const Entry &entry = this->_entries[pos];
+            if (!entry.IsHole()) {
+                this->Place(Mix(hasher(entry)), pos);
+            }
+        }
+        this->_migrated = stop;
+
+        if (this->_migrated == this->_migrate_end) {
+            free(this->_old_ctrl);
+            this->_old_ctrl = NULL;
+            this->_old_slots = NULL;
+            this->_old_capacity = 0;
+        }
+    }
+
+    void FinishMigration() {
+        while (this->_old_ctrl != NULL) {
+            this->MigrateStep();
+        }
+    }
+
+    // every position of other, live entries copied with copy(to, from, pos)
+    template <typename Copier>
+    void CopyEntriesFrom(const FlatTable &other, const Copier &copy) {
+        this->_size = other._size;
+        // an ordered copy leaves other's holes where they are
+        if (this->_ordered) {
+            this->_free.clear();
+        } else {
+            this->_free = other._free;
+        }
+        this->_entries.clear();
+
+        uint32_t end = other.End();
+        for (uint32_t pos = 0; pos < end; pos++) {
+            this->_entries.emplace_back();
+            if (!other._entries[pos].IsHole()) {
+                copy(this->_entries[pos], other._entries[pos], pos);
+            }
+        }
+    }
+
+    // replaces the index with an empty one of the given capacity
+    void AllocateIndex(size_t capacity) {
+        uint8_t *ctrl = static_cast<uint8_t *>(checked_malloc(capacity * (sizeof(uint8_t) + sizeof(uint32_t))));
+        free(this->_ctrl);
+
+        this->_ctrl = ctrl;
+        this->_slots = reinterpret_cast<uint32_t *>(ctrl + capacity);
+        this->_capacity = capacity;
+        this->_deleted = 0;
+        this->_growth_left = MaxLoad(capacity);
+        this->_flooded = false;
+        memset(this->_ctrl, kEmpty, capacity);
+    }
+
+    // rebuilds the index from the dense entries in one go, entries don't
+    // move
+    void Rehash(size_t capacity) {
+        this->AllocateIndex(capacity);
+        this->_rehashes++;
+
+        Hasher hasher;
+        uint32_t end = this->End();
+        for (uint32_t pos = 0; pos < end; pos++) {
+            const Entry &entry = this->_entries[pos];
+            if (!entry.IsHole()) {
+                this->Place(Mix(hasher(entry)), pos);
+            }
+        }
+    }
+
+    std::deque<Entry> _entries;
+    // holes in _entries that can be handed out again
+    std::vector<uint32_t> _free;
+
+    // _capacity control bytes followed by _capacity positions, in one block
+    uint8_t *_ctrl;
+    uint32_t *_slots;
+    size_t _capacity;
+
+    // the index being migrated away from, NULL when there isn't one.
+    // Positions from _migrated up to _migrate_end are still in it
+    uint8_t *_old_ctrl;
+    uint32_t *_old_slots;
+    size_t _old_capacity;
+    uint32_t _migrated;
+    uint32_t _migrate_end;
+
+    size_t _size;
+    // slots marked deleted in the index
+    size_t _deleted;
+    // empty slots that can still be filled before the next rebuild
+    size_t _growth_left;
+    size_t _rehashes;
+    bool _ordered;
+    // set by Place once a probe gets to kFloodProbe groups, and the size
+    // of the index when it was last reseeded
+    bool _flooded;
+    size_t _reseed_capacity;
+    size_t _reseeds;
+    size_t _inserts_since_reseed;
+};
+
+template <typename Entry, typename Hasher>
+const uint32_t FlatTable<Entry, Hasher>::npos;
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <random>
+
+// entries keep their key's hash in 32 bits, next to their version
+typedef uint32_t key_hash_t;
+
+// FNV-1a over a run of bytes, pass the previous result back in as hash
+// to hash something in pieces. It isn't seeded, so it's only for hashes
+// that have to come out the same in every process, like the ones in
+// snapshot files. Anyone can pick keys that collide under it
+inline uint64_t hash_bytes(const void *data, size_t length, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline key_hash_t hash_fold(uint64_t hash) {
+    return static_cast<key_hash_t>(hash ^ (hash >> 32));
+}
+
+// the secret key of the seeded hashes below. Tables whose keys can come
+// from someone else each hash with their own random seed, so nobody can
+// work out keys that collide
+struct HashSeed {
+    uint64_t k0;
+    uint64_t k1;
+    // numbers and identities are hashed with SipHash too, not just
+    // strings. For a table that got flooded even with a seed of its own
+    bool strong;
+};
+
+inline HashSeed random_hash_seed(bool strong = false) {
+    std::random_device random;
+    HashSeed seed;
+    seed.k0 = (static_cast<uint64_t>(random()) << 32) ^ random();
+    seed.k1 = (static_cast<uint64_t>(random()) << 32) ^ random();
+    seed.strong = strong;
+    return seed;
+}
+
+// the seed tables start out with, random for every process. A table
+// that gets flooded anyway moves on to a random_hash_seed of its own
+inline const HashSeed &process_hash_seed() {
+    static const HashSeed seed = random_hash_seed();
+    return seed;
+}
+
+// tables with the same seed can take each other's hashes as they are
+inline bool same_hash_seed(const HashSeed &a, const HashSeed &b) {
+    return a.k0 == b.k0 && a.k1 == b.k1 && a.strong == b.strong;
+}
+
+inline uint64_t hash_rotl(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+inline void hash_sip_round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+    v0 += v1; v1 = hash_rotl(v1, 13); v1 ^= v0; v0 = hash_rotl(v0, 32);
+    v2 += v3; v3 = hash_rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = hash_rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = hash_rotl(v1, 17); v1 ^= v2; v2 = hash_rotl(v2, 32);
+}
+
+// SipHash-1-3, fed a run of bytes at a time, for strings that are read
+// out in pieces. Words are read in host byte order, the hashes never
+// leave the process
+class SeededHasher {
+public:
+    explicit SeededHasher(const HashSeed &seed)
+        : _v0(seed.k0 ^ 0x736f6d6570736575ULL), _v1(seed.k1 ^ 0x646f72616e646f6dULL)
+        , _v2(seed.k0 ^ 0x6c7967656e657261ULL), _v3(seed.k1 ^ 0x7465646279746573ULL)
+        , _tail(0), _length(0) {}
+
+    void Update(const void *data, size_t length) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        size_t i = 0;
+
+        // finish the word the last piece left half done
+        for (; i < length && (this->_length & 7) != 0; i++, this->_length++) {
+            this->_tail |= static_cast<uint64_t>(bytes[i]) << (8 * (this->_length & 7));
+            if ((this->_length & 7) == 7) {
+                this->Compress(this->_tail);
+                this->_tail = 0;
+            }
+        }
+        for (; i + 8 <= length; i += 8, this->_length += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            this->Compress(word);
+        }
+        for (; i < length; i++, this->_length++) {
+            this->_tail |= static_cast<uint64_t>(bytes[i]) << (8 * (this->_length & 7));
+        }
+    }
+
+    key_hash_t Final() {
+        this->Compress(this->_tail | (static_cast<uint64_t>(this->_length) << 56));
+        this->_v2 ^= 0xff;
+        hash_sip_round(this->_v0, this->_v1, this->_v2, this->_v3);
+        hash_sip_round(this->_v0, this->_v1, this->_v2, this->_v3);
+        hash_sip_round(this->_v0, this->_v1, this->_v2, this->_v3);
+        return hash_fold(this->_v0 ^ this->_v1 ^ this->_v2 ^ this->_v3);
+    }
+
+private:
+    void Compress(uint64_t word) {
+        this->_v3 ^= word;
+        hash_sip_round(this->_v0, this->_v1, this->_v2, this->_v3);
+        this->_v0 ^= word;
+    }
+
+    uint64_t _v0, _v1, _v2, _v3;
+    // the bytes of the last, unfinished word
+    uint64_t _tail;
+    uint64_t _length;
+};
+
+// SipHash-1-3 over a run of bytes, for strings
+inline key_hash_t hash_bytes_seeded(const void *data, size_t length, const HashSeed &seed) {
+    SeededHasher hasher(seed);
+    hasher.Update(data, length);
+    return hasher.Final();
+}
+
+// the 128 bit product of a and b, its two halves xored together
+inline uint64_t hash_mum(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t lo = (cross << 32) | (lo_lo & 0xffffffff);
+    uint64_t hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    return lo ^ hi;
+#endif
+}
+
+// a single 64 bit word hashed the way wyhash does it, two multiplications
+// with the seed mixed in, for numbers and for hashes V8 already has
+inline key_hash_t hash_word_seeded(uint64_t word, const HashSeed &seed) {
+    if (seed.strong) {
+        return hash_bytes_seeded(&word, sizeof(word), seed);
+    }
+    uint64_t mixed = hash_mum(word ^ seed.k0, seed.k1 ^ 0xe7037ed1a0b428dbULL);
+    return hash_fold(hash_mum(mixed ^ 0x8ebc6af09c88c6e3ULL, seed.k0 ^ 0x589965cc75374cc3ULL));
+}
+
+// hashes a double by its bits, with 0 and -0 folded together and every
+// NaN folded into one, since maps take them as the same key
+inline key_hash_t hash_double(double number, const HashSeed &seed) {
+    if (number == 0) {
+        number = 0;
+    } else if (number != number) {
+        uint64_t nan = 0x7ff8000000000000ULL;
+        memcpy(&number, &nan, sizeof(number));
+    }
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return hash_word_seeded(bits, seed);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "iterable_map.h"
+
+using namespace v8;
+
+IterableMap::IterableMap() {
+    this->_version = 0;
+    this->_iterator_count = 0;
+}
+
+IterableMap::~IterableMap() {
+}
+
+uint32_t IterableMap::StartIterator() {
+    uint32_t version = this->_version;
+    this->_version++;
+    this->_iterator_count++;
+
+    // return the latest version that should be valid for this iterator
+    return version;
+}
+
+// iterators walk the entries by position, and entries never move, so
+// nothing has to be cleaned up or restored when the last one finishes
+void IterableMap::StopIterator() {
+    this->_iterator_count--;
+}
+
+bool IterableMap::Populate(Local<Object> self, Local<Value> iterable, bool entries) {
+    Local<String> set = Nan::New(entries ? "set" : "add").ToLocalChecked();
+    Local<String> next = Nan::New("next").ToLocalChecked();
+    Local<String> done = Nan::New("done").ToLocalChecked();
+    Local<String> value = Nan::New("value").ToLocalChecked();
+    Local<Symbol> symbol_iterator = Symbol::GetIterator(Isolate::GetCurrent());
+    Local<Object> info0;
+    Local<Object> iter;
+    Local<Object> iter_obj;
+    Local<Array> value_arr;
+    Local<Value> func_args[2];
+    Local<Function> setter;
+    Local<Function> next_func;
+
+    if (!self->Has(set) || !Nan::Get(self, set).ToLocalChecked()->IsFunction()) {
+        Nan::ThrowTypeError("Invalid set method");
+        return false;
+
+    }
+    setter = Nan::Get(self, set).ToLocalChecked().As<Function>();
+    if (!iterable->IsObject()) {
+        Nan::ThrowTypeError("Invalid argument");
+        return false;
+    }
+    info0 = Nan::To<Object>(iterable).ToLocalChecked();
+    if (!info0->Has(symbol_iterator)) {
+        Nan::ThrowTypeError("Argument not iterable");
+        return false;
+    }
+
+    iter = Nan::To<Object>(Nan::Call(Nan::Get(info0, symbol_iterator).ToLocalChecked().As<Function>(), info0, 0, 0).ToLocalChecked()).ToLocalChecked();
+    next_func = Nan::Get(iter, next).ToLocalChecked().As<Function>();
+    iter_obj = Nan::Call(next_func, iter, 0, 0).ToLocalChecked()->ToObject();
+    while(!Nan::Get(iter_obj, done).ToLocalChecked()->BooleanValue()) {
+        if (!entries) {
+            func_args[0] = Nan::Get(iter_obj, value).ToLocalChecked();
+            if (Nan::Call(setter, self, 1, func_args).IsEmpty()) {
+                return false;
+            }
+        } else if (Nan::Get(iter_obj, value).ToLocalChecked()->IsArray()) {
+            value_arr = Nan::Get(iter_obj, value).ToLocalChecked().As<Array>();
+            if (value_arr->Length() >= 2) {
+                func_args[0] = Nan::Get(value_arr, 0).ToLocalChecked();
+                func_args[1] = Nan::Get(value_arr, 1).ToLocalChecked();
+                if (Nan::Call(setter, self, 2, func_args).IsEmpty()) {
+                    // set threw, leave its exception pending
+                    return false;
+                }
+            } else {
+              Nan::ThrowTypeError("Iterator contains non-entry object");
+              return false;
+            }
+        } else {
+          Nan::ThrowTypeError("Iterator contains non-entry object");
+          return false;
+        }
+        iter_obj = Nan::Call(next_func, iter, 0, 0).ToLocalChecked()->ToObject();
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef ITERABLE_MAP_H
+#define ITERABLE_MAP_H
+
+#include <node.h>
+#include <nan.h>
+
+// what every map class shares with PairNodeIterator: entries sit at stable
+// positions from 0 up to GetEnd(), with holes in between, and each one is
+// tagged with the version it was set in
+class IterableMap : public Nan::ObjectWrap {
+public:
+    uint32_t StartIterator();
+    void StopIterator();
+
+    virtual uint32_t GetEnd() = 0;
+    virtual bool IsValid(uint32_t pos, uint32_t version) = 0;
+    virtual v8::Local<v8::Value> GetKey(uint32_t pos) = 0;
+    virtual v8::Local<v8::Value> GetValue(uint32_t pos) = 0;
+
+protected:
+    IterableMap();
+    virtual ~IterableMap();
+
+    // runs the iterable handed to a constructor through self.set(key, value),
+    // returns false with an exception thrown if it isn't a valid iterable
+    // of entries. A set passes entries = false to have every value go
+    // through self.add(value) instead
+    static bool Populate(v8::Local<v8::Object> self, v8::Local<v8::Value> iterable, bool entries = true);
+
+    // each time an iterator starts, the _version gets incremented
+    // it is used so that items added after an iterator starts are
+    // not visited in the iterator
+    uint32_t _version;
+    // we keep track of how many running iterators there are
+    uint32_t _iterator_count;
+};
+
+#endif
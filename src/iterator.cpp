@@ -3,7 +3,9 @@
 
 using namespace v8;
 
-Nan::Persistent<FunctionTemplate> PairNodeIterator::_constructor;
+thread_local Nan::Persistent<FunctionTemplate> PairNodeIterator::_constructor;
+thread_local Nan::Persistent<String> PairNodeIterator::_value_name;
+thread_local Nan::Persistent<String> PairNodeIterator::_done_name;
 
 void PairNodeIterator::init(Local<Object> target) {
     Local<FunctionTemplate> tmplt = Nan::New<FunctionTemplate>();
@@ -11,6 +13,10 @@ void PairNodeIterator::init(Local<Object> target) {
     tmplt->InstanceTemplate()->SetInternalFieldCount(1);
     _constructor.Reset(tmplt);
     Nan::SetPrototypeMethod(tmplt, "next", Next);
+    Nan::SetPrototypeMethod(tmplt, "nextBatch", NextBatch);
+
+    _value_name.Reset(String::NewFromUtf8(Isolate::GetCurrent(), "value", NewStringType::kInternalized).ToLocalChecked());
+    _done_name.Reset(String::NewFromUtf8(Isolate::GetCurrent(), "done", NewStringType::kInternalized).ToLocalChecked());
 
     // got to do the Symbol.iterator function by hand, no Nan support
     Local<Symbol> symbol_iterator = Symbol::GetIterator(Isolate::GetCurrent());
@@ -22,7 +28,7 @@ void PairNodeIterator::init(Local<Object> target) {
     get_this_templt->SetClassName(Nan::New("Symbol(Symbol.iterator)").ToLocalChecked());
 }
 
-Local<Object> PairNodeIterator::New(int type, NodeMap *map_obj) {
+Local<Object> PairNodeIterator::New(int type, IterableMap *map_obj) {
     Local<FunctionTemplate> constructor = Nan::New<FunctionTemplate>(_constructor);
     Local<Object> obj;
     PairNodeIterator *iter = new PairNodeIterator(type, map_obj);
@@ -34,16 +40,41 @@ Local<Object> PairNodeIterator::New(int type, NodeMap *map_obj) {
     return obj;
 }
 
-PairNodeIterator::PairNodeIterator(int type, NodeMap *map_obj) {
+PairNodeIterator::PairNodeIterator(int type, IterableMap *map_obj) {
     this->_map_obj = map_obj;
     this->_version = map_obj->StartIterator();
-    this->_iter = map_obj->GetBegin();
-    this->_end = map_obj->GetEnd();
+    this->_pos = 0;
     this->_type = type;
+    this->_done = false;
 }
 
 PairNodeIterator::~PairNodeIterator() {
+    if (!this->_done) {
+        this->_map_obj->StopIterator();
+    }
+}
+
+bool PairNodeIterator::Advance() {
+    if (this->_done) {
+        return false;
+    }
+
+    uint32_t end = this->_map_obj->GetEnd();
+
+    // skip holes and anything added since the iterator started
+    while (this->_pos < end && !this->_map_obj->IsValid(this->_pos, this->_version)) {
+        this->_pos++;
+    }
+
+    if (this->_pos < end) {
+        return true;
+    }
+
+    // a finished iterator lets go of the map right away, instead of when
+    // it gets garbage collected
+    this->_done = true;
     this->_map_obj->StopIterator();
+    return false;
 }
 
 // iterator[Symbol.iterator]() : this
@@ -58,12 +89,12 @@ NAN_METHOD(PairNodeIterator::Next) {
     Nan::HandleScope scope;
 
     PairNodeIterator *iter = ObjectWrap::Unwrap<PairNodeIterator >(info.This());
-    Local<String> value = Nan::New("value").ToLocalChecked();
-    Local<String> done = Nan::New("done").ToLocalChecked();
+    Local<String> value = Nan::New(_value_name);
+    Local<String> done = Nan::New(_done_name);
     Local<Object> obj = Nan::New<Object>();
     Local<Array> arr;
 
-    if (iter->_iter == iter->_end) {
+    if (!iter->Advance()) {
         Nan::Set(obj, value, Nan::Undefined());
         Nan::Set(obj, done, Nan::True());
         info.GetReturnValue().Set(obj);
@@ -71,18 +102,59 @@ NAN_METHOD(PairNodeIterator::Next) {
     }
 
     if (iter->_type == KEY_TYPE) {
-        obj->Set(value, iter->_iter->GetLocalKey());
+        obj->Set(value, iter->_map_obj->GetKey(iter->_pos));
     } else if (iter->_type == VALUE_TYPE) {
-        obj->Set(value, iter->_iter->GetLocalValue());
+        obj->Set(value, iter->_map_obj->GetValue(iter->_pos));
     } else {
         arr = Nan::New<Array>(2);
-        arr->Set(0, iter->_iter->GetLocalKey());
-        arr->Set(1, iter->_iter->GetLocalValue());
+        arr->Set(0, iter->_map_obj->GetKey(iter->_pos));
+        arr->Set(1, iter->_map_obj->GetValue(iter->_pos));
         obj->Set(value, arr);
     }
     obj->Set(done, Nan::False());
 
-    iter->_iter++;
+    iter->_pos++;
     info.GetReturnValue().Set(obj);
     return;
 }
+
+// iterator.nextBatch(count, [array]) : array
+NAN_METHOD(PairNodeIterator::NextBatch) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsUint32() || Nan::To<uint32_t>(info[0]).FromJust() == 0) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    PairNodeIterator *iter = ObjectWrap::Unwrap<PairNodeIterator >(info.This());
+    uint32_t count = Nan::To<uint32_t>(info[0]).FromJust();
+    Local<Array> arr;
+    uint32_t length = 0;
+
+    if (info.Length() > 1 && info[1]->IsArray()) {
+        arr = info[1].As<Array>();
+    } else {
+        arr = Nan::New<Array>();
+    }
+
+    for (uint32_t i = 0; i < count && iter->Advance(); i++) {
+        if (iter->_type == KEY_TYPE) {
+            Nan::Set(arr, length++, iter->_map_obj->GetKey(iter->_pos));
+        } else if (iter->_type == VALUE_TYPE) {
+            Nan::Set(arr, length++, iter->_map_obj->GetValue(iter->_pos));
+        } else {
+            Nan::Set(arr, length++, iter->_map_obj->GetKey(iter->_pos));
+            Nan::Set(arr, length++, iter->_map_obj->GetValue(iter->_pos));
+        }
+        iter->_pos++;
+    }
+
+    // a reused array may have been longer
+    if (arr->Length() != length) {
+        Nan::Set(arr, Nan::New("length").ToLocalChecked(), Nan::New<Integer>(length));
+    }
+
+    info.GetReturnValue().Set(arr);
+    return;
+}
@@ -5,33 +5,49 @@
 #include <iostream>
 #include <node.h>
 #include <nan.h>
-#include "map.h"
+#include "iterable_map.h"
 
 class PairNodeIterator : public Nan::ObjectWrap {
 public:
     static void init(v8::Local<v8::Object> target);
-    static v8::Local<v8::Object> New(int type, NodeMap *obj);
+    static v8::Local<v8::Object> New(int type, IterableMap *obj);
 
     const static int KEY_TYPE = 1;
     const static int VALUE_TYPE = 1 << 1;
 
 private:
-    static Nan::Persistent<v8::FunctionTemplate> _constructor;
-
-    PairNodeIterator(int type, NodeMap *map_obj);
+    // handles belong to an isolate, and each worker thread has its own
+    static thread_local Nan::Persistent<v8::FunctionTemplate> _constructor;
+    // the property names of next()'s result, made once as internalized
+    // strings instead of on every call
+    static thread_local Nan::Persistent<v8::String> _value_name;
+    static thread_local Nan::Persistent<v8::String> _done_name;
+
+    PairNodeIterator(int type, IterableMap *map_obj);
     ~PairNodeIterator();
 
     uint32_t _version;
-    MapType::const_iterator _iter;
-    MapType::const_iterator _end;
-    NodeMap *_map_obj;
+    // position of the next entry to look at
+    uint32_t _pos;
+    IterableMap *_map_obj;
     int _type = KEY_TYPE & VALUE_TYPE;
+    // set once the iterator has run off the end and stopped
+    bool _done;
+
+    // moves _pos to the next entry this iterator should visit, returns
+    // false once there are none left
+    bool Advance();
 
     // iterator[Symbol.iterator]() : this
     static NAN_METHOD(GetThis);
 
     // iterator.next() : {value:, done:}
     static NAN_METHOD(Next);
+
+    // iterator.nextBatch(count, [array]) : array
+    // fills array (or a new one) with up to count keys, values, or
+    // flattened key, value pairs; it comes back empty when done
+    static NAN_METHOD(NextBatch);
 };
 
 #endif
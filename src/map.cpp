@@ -1,9 +1,17 @@
 #include "map.h"
+#include <limits.h>
+#include <string.h>
 #include <iostream>
 #include "iterator.h"
+#include "primitive_map.h"
+#include "set.h"
+#include "shared_map.h"
+#include "snapshot.h"
 
 using namespace v8;
 
+thread_local Nan::Persistent<FunctionTemplate> NodeMap::_constructor;
+
 void NodeMap::init(Local<Object> target) {
     Nan::HandleScope scope;
 
@@ -18,6 +26,7 @@ void NodeMap::init(Local<Object> target) {
     constructor->PrototypeTemplate()->Set(symbol_iterator, entries_templt);
     entries_templt->SetClassName(Nan::New("Symbol(Symbol.iterator)").ToLocalChecked());
 
+    _constructor.Reset(constructor);
     constructor->SetClassName(Nan::New("NodeMap").ToLocalChecked());
     constructor->InstanceTemplate()->SetInternalFieldCount(1);
 
@@ -30,127 +39,781 @@ void NodeMap::init(Local<Object> target) {
     Nan::SetPrototypeMethod(constructor, "delete", Delete);
     Nan::SetPrototypeMethod(constructor, "clear", Clear);
     Nan::SetPrototypeMethod(constructor, "forEach", ForEach);
+    Nan::SetPrototypeMethod(constructor, "get2", GetComposite<2>);
+    Nan::SetPrototypeMethod(constructor, "has2", HasComposite<2>);
+    Nan::SetPrototypeMethod(constructor, "set2", SetComposite<2>);
+    Nan::SetPrototypeMethod(constructor, "delete2", DeleteComposite<2>);
+    Nan::SetPrototypeMethod(constructor, "get3", GetComposite<3>);
+    Nan::SetPrototypeMethod(constructor, "has3", HasComposite<3>);
+    Nan::SetPrototypeMethod(constructor, "set3", SetComposite<3>);
+    Nan::SetPrototypeMethod(constructor, "delete3", DeleteComposite<3>);
+    Nan::SetPrototypeMethod(constructor, "getOrSet", GetOrSet);
+    Nan::SetPrototypeMethod(constructor, "update", Update);
+    Nan::SetPrototypeMethod(constructor, "increment", Increment);
+    Nan::SetPrototypeMethod(constructor, "clone", Clone);
+    Nan::SetPrototypeMethod(constructor, "merge", Merge);
+    Nan::SetPrototypeMethod(constructor, "filter", Filter);
+    Nan::SetPrototypeMethod(constructor, "keysArray", KeysArray);
+    Nan::SetPrototypeMethod(constructor, "valuesArray", ValuesArray);
+    Nan::SetPrototypeMethod(constructor, "entriesArray", EntriesArray);
+    Nan::SetPrototypeMethod(constructor, "setMany", SetMany);
+    Nan::SetPrototypeMethod(constructor, "getMany", GetMany);
+    Nan::SetPrototypeMethod(constructor, "hasMany", HasMany);
+    Nan::SetPrototypeMethod(constructor, "deleteMany", DeleteMany);
+    Nan::SetPrototypeMethod(constructor, "reserve", Reserve);
+    Nan::SetPrototypeMethod(constructor, "shrinkToFit", ShrinkToFit);
+    Nan::SetPrototypeMethod(constructor, "stats", Stats);
+    Nan::SetPrototypeMethod(constructor, "memoryUsage", MemoryUsage);
+    Nan::SetPrototypeMethod(constructor, "countOperations", CountOperations);
+#ifdef SERIALIZED_STORE_SUPPORTED
+    Nan::SetPrototypeMethod(constructor, "saveSnapshot", SaveSnapshot);
+    Nan::SetMethod(constructor, "openSnapshot", OpenSnapshot);
+#endif
     Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("size").ToLocalChecked(), Size);
+    Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("serializedBytes").ToLocalChecked(), SerializedBytes);
 
     target->Set(Nan::New("NodeMap").ToLocalChecked(), constructor->GetFunction());
 
-    PairNodeIterator::init(target);
 }
 
-NodeMap::NodeMap() {
-    this->_version = 0;
-    this->_iterator_count = 0;
+NodeMap::NodeMap()
+    : _seed(process_hash_seed())
+    , _store(NULL)
+    , _serialized(NULL)
+    , _max_size(0)
+    , _policy(EVICT_NONE)
+    , _newest(VersionedPersistentPair::kNoLink)
+    , _oldest(VersionedPersistentPair::kNoLink)
+    , _clock_hand(0)
+    , _wheel(NULL)
+    , _ttl(0)
+    , _expiry_timer(NULL)
+    , _expiry_due(0)
+    , _expiry_resource(NULL)
+    , _counters(NULL)
+    , _reported_bytes(0) {
+}
+
+static void FreeTimer(uv_handle_t *timer) {
+    delete reinterpret_cast<uv_timer_t *>(timer);
+}
+
+// Nan::AdjustExternalMemory takes an int, a big table can change by more
+static void AdjustExternalMemory(int64_t change) {
+    while (change != 0) {
+        int step = change > INT_MAX ? INT_MAX : change < -INT_MAX ? -INT_MAX : static_cast<int>(change);
+        Nan::AdjustExternalMemory(step);
+        change -= step;
+    }
 }
 
 NodeMap::~NodeMap() {
-    for(MapType::const_iterator itr = this->_set.begin(); itr != this->_set.end(); ) {
-        itr = this->_set.erase(itr);
+    delete this->_store;
+    delete this->_serialized;
+    delete this->_wheel;
+    this->_on_evict.Reset();
+    this->_on_expire.Reset();
+    if (this->_expiry_timer != NULL) {
+        // the loop still holds the handle until it's closed
+        uv_timer_stop(this->_expiry_timer);
+        uv_close(reinterpret_cast<uv_handle_t *>(this->_expiry_timer), FreeTimer);
+    }
+    delete this->_expiry_resource;
+    delete this->_counters;
+    AdjustExternalMemory(-static_cast<int64_t>(this->_reported_bytes));
+}
+
+uint32_t NodeMap::GetEnd() {
+    return this->_set.End();
+}
+
+bool NodeMap::IsValid(uint32_t pos, uint32_t version) {
+    return this->_set.At(pos).IsValid(version);
+}
+
+Local<Value> NodeMap::GetKey(uint32_t pos) {
+    if (this->_store != NULL) {
+        return this->_store->GetKey(pos);
+    }
+    return this->_set.At(pos).GetLocalKey();
+}
+
+Local<Value> NodeMap::GetValue(uint32_t pos) {
+    if (this->_serialized != NULL) {
+        return this->_serialized->Get(pos);
+    }
+    if (this->_store != NULL) {
+        return this->_store->GetValue(pos);
+    }
+
+    const VersionedPersistentPair &entry = this->_set.At(pos);
+    if (!entry.HasValue()) {
+        return Nan::New<Number>(this->_numbers[pos]);
     }
+    return entry.GetLocalValue();
 }
 
-uint32_t NodeMap::StartIterator() {
-    uint32_t version = this->_version;
-    this->_version++;
-    if (this->_iterator_count == 0) {
-        // if this is the first iterator, set the max load facto to infinity
-        // so that a rehash doesn't happen while iterating
-        this->_old_load_factor = this->_set.max_load_factor();
-        this->_set.max_load_factor(std::numeric_limits<float>::infinity());
+bool NodeMap::GetNumber(uint32_t pos, double *number) {
+    if (this->_store == NULL && this->_serialized == NULL && !this->_set.At(pos).HasValue()) {
+        *number = this->_numbers[pos];
+        return true;
     }
-    this->_iterator_count++;
 
-    // return the latest version that should be valid for this iterator
-    return version;
+    Local<Value> value = this->GetValue(pos);
+    if (value.IsEmpty() || !value->IsNumber()) {
+        return false;
+    }
+    *number = value.As<Number>()->Value();
+    return true;
 }
 
-void NodeMap::StopIterator() {
-    this->_iterator_count--;
-    if (this->_iterator_count != 0) {
-        return;
+uint32_t NodeMap::FindEntry(const KeyView &key) {
+    if (this->_store != NULL) {
+        return this->_set.Find(key.GetHash(), array_store_equal_to(key, this->_store));
+    }
+    return this->_set.Find(key.GetHash(), v8_value_equal_to(key));
+}
+
+uint32_t NodeMap::FindEntry(const KeyView &key, MapType::InsertHint *hint) {
+    if (this->_store != NULL) {
+        return this->_set.FindOrPrepare(key.GetHash(), array_store_equal_to(key, this->_store), hint);
     }
-    // that was the last iterator running, so now go through the whole set
-    // and actually delete anything marked for deletion
-    for(MapType::const_iterator itr = this->_set.begin(); itr != this->_set.end(); ) {
-        if (itr->IsDeleted()) {
-            itr = this->_set.erase(itr);
+    return this->_set.FindOrPrepare(key.GetHash(), v8_value_equal_to(key), hint);
+}
+
+uint32_t NodeMap::LookupEntry(const KeyView &key, MapType::InsertHint *hint) {
+    uint32_t pos = hint == NULL ? this->FindEntry(key) : this->FindEntry(key, hint);
+
+    if (this->_counters != NULL) {
+        if (pos == MapType::npos) {
+            this->_counters->misses++;
         } else {
-            itr++;
+            this->_counters->hits++;
         }
     }
-    // since it was the last iterator, reset the max load factor back
-    // to what it was before the first iterator, this might cause a
-    // rehash to happen
-    this->_set.max_load_factor(this->_old_load_factor);
+    return pos;
 }
 
-MapType::const_iterator NodeMap::GetBegin() {
-    return this->_set.begin();
+void NodeMap::Reseed() {
+    Nan::HandleScope scope;
+
+    this->_seed = random_hash_seed(this->_set.Reseeds() != 0);
+    this->_set.Reseed(EntryRehasher(this));
 }
 
-MapType::const_iterator NodeMap::GetEnd() {
-    return this->_set.end();
+Nan::Maybe<bool> NodeMap::SetEntry(const KeyView &key, Local<Value> value, uint32_t ttl) {
+    MapType::InsertHint hint;
+    // a map that serializes its values looks the key up once that's done
+    uint32_t pos = this->_serialized == NULL ? this->FindEntry(key, &hint) : MapType::npos;
+
+    return this->SetFoundEntry(key, pos, hint, value, NULL, &ttl);
 }
 
-NAN_METHOD(NodeMap::Constructor) {
-    Nan::HandleScope scope;
-    NodeMap *obj = new NodeMap();
+Nan::Maybe<bool> NodeMap::SetFoundEntry(const KeyView &key, uint32_t pos, MapType::InsertHint hint,
+                                        Local<Value> value, const double *number, const uint32_t *ttl) {
+    SerializedValue serialized = {NULL, 0};
+
+    // a value that is kept serialized is written out before the table is
+    // touched, so one that can't be leaves the map as it was. Serializing
+    // can run getters, which could change the map too, so the key is
+    // only looked up after
+    if (this->_serialized != NULL) {
+        if (number != NULL) {
+            value = Nan::New<Number>(*number);
+            number = NULL;
+        }
+        if (!SerializedStore::Serialize(value, &serialized)) {
+            return Nan::Nothing<bool>();
+        }
+        value = Local<Value>();
+        pos = this->FindEntry(key, &hint);
+    } else if (number != NULL && this->_store != NULL) {
+        value = Nan::New<Number>(*number);
+        number = NULL;
+    }
 
-    Local<String> set = Nan::New("set").ToLocalChecked();
-    Local<String> next = Nan::New("next").ToLocalChecked();
-    Local<String> done = Nan::New("done").ToLocalChecked();
-    Local<String> value = Nan::New("value").ToLocalChecked();
-    Local<Symbol> symbol_iterator = Symbol::GetIterator(Isolate::GetCurrent());
-    Local<Object> info0;
-    Local<Object> iter;
-    Local<Object> iter_obj;
-    Local<Array> value_arr;
-    Local<Value> func_args[2];
-    Local<Function> setter;
-    Local<Function> next_func;
+    bool added = pos == MapType::npos;
+    Local<Value> evicted_key;
+    Local<Value> evicted_value;
 
-    obj->Wrap(info.This());
-    info.GetReturnValue().Set(info.This());
+    if (added && this->_max_size != 0 && this->_set.Size() >= this->_max_size) {
+        this->Evict(&evicted_key, &evicted_value);
+    }
+
+    if (added) {
+        this->CompactIfIdle();
+        pos = this->_set.Insert(key.GetHash(), hint);
+        this->AssignEntry(pos, key, value);
+        this->LinkNewest(pos);
+        if (this->_counters != NULL) {
+            this->_counters->inserts++;
+        }
+    } else {
+        this->ReplaceEntry(pos, value);
+        this->Touch(pos);
+    }
+    if (this->_serialized != NULL) {
+        this->_serialized->Set(pos, serialized);
+    }
+    if (number != NULL) {
+        if (pos >= this->_numbers.size()) {
+            this->_numbers.resize(this->_set.End());
+        }
+        this->_numbers[pos] = *number;
+    }
+    if (ttl != NULL || added) {
+        uint32_t expiry = ttl != NULL ? *ttl : this->_ttl;
+        if (expiry != 0) {
+            uint64_t now = uv_now(Nan::GetCurrentEventLoop());
+            if (this->_wheel == NULL) {
+                this->_wheel = new TimerWheel(now);
+            }
+            this->_wheel->Schedule(pos, now + expiry);
+            this->ScheduleExpiry(now + expiry);
+        } else if (this->_wheel != NULL) {
+            this->_wheel->Cancel(pos);
+        }
+    }
+    if (added && this->_set.Flooded()) {
+        this->Reseed();
+    }
+    this->ReportMemory(false);
+
+    // the callback only runs once the map is whole again, it can use it
+    if (!evicted_key.IsEmpty()) {
+        Local<Value> argv[3] = {evicted_value, evicted_key, this->handle()};
+        if (Nan::Call(Nan::New(this->_on_evict), Nan::GetCurrentContext()->Global(), 3, argv).IsEmpty()) {
+            return Nan::Nothing<bool>();
+        }
+    }
+    return Nan::Just(added);
+}
 
-    if(info.Length() == 0) {
+// a hit moves an entry to the new end of an LRU map's list, and marks it
+// used for the hand of a CLOCK map
+void NodeMap::Touch(uint32_t pos) {
+    if (this->_policy == EVICT_LRU && this->_newest != pos) {
+        this->Unlink(pos);
+        this->LinkNewest(pos);
+    } else if (this->_policy == EVICT_CLOCK) {
+        this->_set.At(pos).SetReferenced(true);
+    }
+}
+
+void NodeMap::LinkNewest(uint32_t pos) {
+    if (this->_policy != EVICT_LRU) {
         return;
     }
+    VersionedPersistentPair &entry = this->_set.At(pos);
+
+    entry.SetOlder(this->_newest);
+    entry.SetNewer(VersionedPersistentPair::kNoLink);
+    if (this->_newest != VersionedPersistentPair::kNoLink) {
+        this->_set.At(this->_newest).SetNewer(pos);
+    } else {
+        this->_oldest = pos;
+    }
+    this->_newest = pos;
+}
 
-    if (!info.This()->Has(set) || !Nan::Get(info.This(), set).ToLocalChecked()->IsFunction()) {
-        Nan::ThrowTypeError("Invalid set method");
+void NodeMap::Unlink(uint32_t pos) {
+    if (this->_policy != EVICT_LRU) {
         return;
+    }
+    VersionedPersistentPair &entry = this->_set.At(pos);
 
+    if (entry.GetOlder() != VersionedPersistentPair::kNoLink) {
+        this->_set.At(entry.GetOlder()).SetNewer(entry.GetNewer());
+    } else {
+        this->_oldest = entry.GetNewer();
+    }
+    if (entry.GetNewer() != VersionedPersistentPair::kNoLink) {
+        this->_set.At(entry.GetNewer()).SetOlder(entry.GetOlder());
+    } else {
+        this->_newest = entry.GetOlder();
+    }
+}
+
+void NodeMap::Relink(uint32_t pos) {
+    VersionedPersistentPair &entry = this->_set.At(pos);
+
+    if (entry.GetOlder() != VersionedPersistentPair::kNoLink) {
+        this->_set.At(entry.GetOlder()).SetNewer(pos);
+    } else {
+        this->_oldest = pos;
+    }
+    if (entry.GetNewer() != VersionedPersistentPair::kNoLink) {
+        this->_set.At(entry.GetNewer()).SetOlder(pos);
+    } else {
+        this->_newest = pos;
+    }
+}
+
+// the least recently used entry, or for CLOCK the first one the hand finds
+// that wasn't used since it last went by. The hand clears marks as it
+// goes, so it stops within two turns
+uint32_t NodeMap::NextVictim() {
+    if (this->_policy == EVICT_LRU) {
+        return this->_oldest;
+    }
+    for (;;) {
+        if (this->_clock_hand >= this->_set.End()) {
+            this->_clock_hand = 0;
+        }
+        VersionedPersistentPair &entry = this->_set.At(this->_clock_hand++);
+        if (entry.IsHole()) {
+            continue;
+        }
+        if (!entry.IsReferenced()) {
+            return this->_clock_hand - 1;
+        }
+        entry.SetReferenced(false);
+    }
+}
+
+// expired entries are all dropped before any onExpire callback runs, so the
+// callbacks see the map without them
+bool NodeMap::ExpireEntries(bool from_timer) {
+    std::vector<uint32_t> expired;
+    this->_wheel->Advance(uv_now(Nan::GetCurrentEventLoop()), &expired);
+    if (expired.empty()) {
+        return true;
+    }
+
+    Nan::HandleScope scope;
+    bool callback = !this->_on_expire.IsEmpty();
+
+    if (this->_counters != NULL) {
+        this->_counters->expirations += expired.size();
+    }
+    std::vector<Local<Value> > entries;
+
+    for (size_t i = 0; i < expired.size(); i++) {
+        if (callback) {
+            entries.push_back(this->GetValue(expired[i]));
+            entries.push_back(this->GetKey(expired[i]));
+        }
+        this->ErasePosition(expired[i]);
+    }
+    this->CompactIfIdle();
+    this->ReportMemory(false);
+
+    Local<Function> cb = Nan::New(this->_on_expire);
+    for (size_t i = 0; i < entries.size(); i += 2) {
+        Local<Value> argv[3] = {entries[i], entries[i + 1], this->handle()};
+        // from the timer there's no JS below to throw to, so it goes
+        // through node like any other callback
+        if (from_timer) {
+            this->_expiry_resource->runInAsyncScope(this->handle(), cb, 3, argv);
+        } else if (Nan::Call(cb, Nan::GetCurrentContext()->Global(), 3, argv).IsEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// makes sure the timer goes off by due
+void NodeMap::ScheduleExpiry(uint64_t due) {
+    uv_loop_t *loop = Nan::GetCurrentEventLoop();
+
+    if (this->_expiry_timer == NULL) {
+        this->_expiry_timer = new uv_timer_t;
+        uv_timer_init(loop, this->_expiry_timer);
+        uv_unref(reinterpret_cast<uv_handle_t *>(this->_expiry_timer));
+        this->_expiry_timer->data = this;
+        this->_expiry_resource = new Nan::AsyncResource("es6-native-map:expiry");
     }
-    setter = Nan::Get(info.This(), set).ToLocalChecked().As<Function>();
-    if (!info[0]->IsObject()) {
-        Nan::ThrowTypeError("Invalid argument");
+    if (uv_is_active(reinterpret_cast<uv_handle_t *>(this->_expiry_timer)) && this->_expiry_due <= due) {
         return;
     }
-    info0 = Nan::To<Object>(info[0]).ToLocalChecked();
-    if (!info0->Has(symbol_iterator)) {
-        Nan::ThrowTypeError("Argument not iterable");
+
+    uint64_t now = uv_now(loop);
+    this->_expiry_due = due;
+    uv_timer_start(this->_expiry_timer, OnExpiryTimer, due > now ? due - now : 0, 0);
+}
+
+void NodeMap::OnExpiryTimer(uv_timer_t *timer) {
+    Nan::HandleScope scope;
+    NodeMap *obj = static_cast<NodeMap *>(timer->data);
+
+    obj->ExpireEntries(true);
+    if (obj->_wheel != NULL && !obj->_wheel->Empty()) {
+        obj->ScheduleExpiry(obj->_wheel->NextDue());
+    }
+}
+
+// the key and value are only handed out when there's a callback to give
+// them to, otherwise an eviction never makes a handle
+void NodeMap::Evict(Local<Value> *key, Local<Value> *value) {
+    uint32_t pos = this->NextVictim();
+
+    if (this->_counters != NULL) {
+        this->_counters->evictions++;
+    }
+    if (!this->_on_evict.IsEmpty()) {
+        *key = this->GetKey(pos);
+        *value = this->GetValue(pos);
+    }
+    this->ErasePosition(pos);
+}
+
+void NodeMap::AssignEntry(uint32_t pos, const KeyView &key, Local<Value> value) {
+    if (this->_store != NULL) {
+        this->_set.At(pos).AssignStored(this->_version, key.GetHash());
+        this->_store->Set(pos, key.GetLocalKey(), value);
+    } else {
+        this->_set.At(pos).Assign(this->_version, key, value);
+    }
+}
+
+void NodeMap::ReplaceEntry(uint32_t pos, Local<Value> value) {
+    if (this->_store != NULL) {
+        this->_set.At(pos).SetVersion(this->_version);
+        this->_store->SetValue(pos, value);
+    } else {
+        this->_set.At(pos).ReplaceValue(this->_version, value);
+    }
+}
+
+KeyView NodeMap::KeyAt(uint32_t pos, const HashSeed &seed) {
+    Local<Value> key = this->GetKey(pos);
+    key_hash_t hash = this->_set.At(pos).GetHash();
+
+    if (!same_hash_seed(seed, this->_seed)) {
+        hash = v8_stored_key_hash(key, (hash & kCompositeHashBit) != 0, seed);
+    }
+    return KeyView(key, hash);
+}
+
+NodeMap *NodeMap::NewInstance(Local<Object> *handle) {
+    Local<Function> constructor = Nan::GetFunction(Nan::New(_constructor)).ToLocalChecked();
+
+    if (!Nan::NewInstance(constructor).ToLocal(handle)) {
+        return NULL;
+    }
+    return Nan::ObjectWrap::Unwrap<NodeMap>(*handle);
+}
+
+void NodeMap::CopyOptions(NodeMap *from) {
+    if (from->_set.IsOrdered()) {
+        this->_set.SetOrdered();
+    }
+    if (from->_store != NULL) {
+        this->_store = new ArrayStore();
+    }
+#ifdef SERIALIZED_STORE_SUPPORTED
+    if (from->_serialized != NULL) {
+        this->_serialized = new SerializedStore();
+    }
+#endif
+    this->_max_size = from->_max_size;
+    this->_policy = from->_policy;
+    if (!from->_on_evict.IsEmpty()) {
+        this->_on_evict.Reset(Nan::New(from->_on_evict));
+    }
+    this->_ttl = from->_ttl;
+    if (!from->_on_expire.IsEmpty()) {
+        this->_on_expire.Reset(Nan::New(from->_on_expire));
+    }
+    // so the entries can keep their hashes
+    this->_seed = from->_seed;
+}
+
+// sets every [key, value] pair of an array, counting the keys that are new
+// in added. Returns false with an exception thrown on a bad element
+bool NodeMap::SetPairs(Local<Array> pairs, uint32_t *added) {
+    uint32_t length = pairs->Length();
+
+    // make room for every key up front, instead of growing along the way
+    this->_set.Reserve(this->_set.Size() + length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        Nan::HandleScope element_scope;
+        Local<Value> pair;
+        Local<Value> key;
+        Local<Value> value;
+
+        if (!Nan::Get(pairs, i).ToLocal(&pair)) {
+            return false;
+        }
+        if (!pair->IsArray() || pair.As<Array>()->Length() < 2) {
+            Nan::ThrowTypeError("Array contains non-entry object");
+            return false;
+        }
+        if (!Nan::Get(pair.As<Object>(), 0).ToLocal(&key) || !Nan::Get(pair.As<Object>(), 1).ToLocal(&value)) {
+            return false;
+        }
+        if (key->IsUndefined() || key->IsNull()) {
+            Nan::ThrowTypeError("Wrong arguments");
+            return false;
+        }
+        Nan::Maybe<bool> set = this->SetEntry(this->MakeKey(key), value, this->_ttl);
+        if (set.IsNothing()) {
+            return false;
+        }
+        if (set.FromJust()) {
+            (*added)++;
+        }
+    }
+    return true;
+}
+
+bool NodeMap::DeleteEntry(const KeyView &key) {
+    uint32_t pos = this->FindEntry(key);
+
+    if (pos == MapType::npos) {
+        return false;
+    }
+
+    this->ErasePosition(pos);
+    this->CompactIfIdle();
+    this->ReportMemory(false);
+    if (this->_counters != NULL) {
+        this->_counters->deletes++;
+    }
+    return true;
+}
+
+// entries are released in place, running iterators just skip the hole
+void NodeMap::ErasePosition(uint32_t pos) {
+    this->Unlink(pos);
+    if (this->_wheel != NULL) {
+        this->_wheel->Cancel(pos);
+    }
+    if (this->_store != NULL) {
+        this->_store->Release(pos);
+    }
+    if (this->_serialized != NULL) {
+        this->_serialized->Release(pos);
+    }
+    this->_set.Erase(pos, this->_set.At(pos).GetHash());
+}
+
+// an ordered table can only move its entries while no iterator is holding
+// a position into it. Holes left behind while there were iterators are
+// picked up by the next insert or delete after they are done
+void NodeMap::CompactIfIdle() {
+    if (this->_iterator_count == 0 && this->_set.NeedsCompaction()) {
+        this->Compact();
+    }
+}
+
+void NodeMap::Compact() {
+    this->_set.Compact(StoreMover(this));
+    this->TruncateStores();
+}
+
+size_t NodeMap::NativeBytes() const {
+    size_t bytes = sizeof(NodeMap) + this->_set.Bytes();
+
+    // an ArrayStore keeps its keys and values in the V8 heap
+    if (this->_store != NULL) {
+        bytes += sizeof(ArrayStore);
+    }
+    if (this->_serialized != NULL) {
+        bytes += sizeof(SerializedStore) + this->_serialized->NativeBytes();
+    }
+    if (this->_wheel != NULL) {
+        bytes += sizeof(TimerWheel) + this->_wheel->Bytes();
+    }
+    if (this->_expiry_timer != NULL) {
+        bytes += sizeof(uv_timer_t);
+    }
+    if (this->_counters != NULL) {
+        bytes += sizeof(OperationCounters);
+    }
+    bytes += this->_numbers.capacity() * sizeof(double);
+    return bytes;
+}
+
+void NodeMap::ReportMemory(bool force) {
+    size_t bytes = this->NativeBytes();
+    size_t change = bytes > this->_reported_bytes ? bytes - this->_reported_bytes : this->_reported_bytes - bytes;
+
+    if (change == 0 || (!force && change < kMemoryReportStep)) {
         return;
     }
+    AdjustExternalMemory(static_cast<int64_t>(bytes) - static_cast<int64_t>(this->_reported_bytes));
+    this->_reported_bytes = bytes;
+}
+
+// drops whatever the stores hold past the end of the table
+void NodeMap::TruncateStores() {
+    if (this->_store != NULL) {
+        this->_store->Truncate(this->_set.End());
+    }
+    if (this->_serialized != NULL) {
+        this->_serialized->Truncate(this->_set.End());
+    }
+    if (this->_wheel != NULL) {
+        this->_wheel->Truncate(this->_set.End());
+    }
+    if (this->_numbers.size() > this->_set.End()) {
+        this->_numbers.resize(this->_set.End());
+    }
+}
+
+NAN_METHOD(NodeMap::Constructor) {
+    Nan::HandleScope scope;
+    NodeMap *obj = new NodeMap();
+    uint32_t capacity = 0;
+
+    obj->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
 
-    iter = Nan::To<Object>(Nan::Call(Nan::Get(info0, symbol_iterator).ToLocalChecked().As<Function>(), info0, 0, 0).ToLocalChecked()).ToLocalChecked();
-    next_func = Nan::Get(iter, next).ToLocalChecked().As<Function>();
-    iter_obj = Nan::Call(next_func, iter, 0, 0).ToLocalChecked()->ToObject();
-    while(!Nan::Get(iter_obj, done).ToLocalChecked()->BooleanValue()) {
-        if (Nan::Get(iter_obj, value).ToLocalChecked()->IsArray()) {
-            value_arr = Nan::Get(iter_obj, value).ToLocalChecked().As<Array>();
-            if (value_arr->Length() >= 2) {
-                func_args[0] = Nan::Get(value_arr, 0).ToLocalChecked();
-                func_args[1] = Nan::Get(value_arr, 1).ToLocalChecked();
-                Nan::Call(setter, info.This(), 2, func_args);
-            } else {
-              Nan::ThrowTypeError("Iterator contains non-entry object");
-              return;
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        Local<Value> option;
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("capacity").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            if (!option->IsUint32()) {
+                Nan::ThrowTypeError("Invalid capacity");
+                return;
             }
-        } else {
-          Nan::ThrowTypeError("Iterator contains non-entry object");
-          return;
+            capacity = Nan::To<uint32_t>(option).FromJust();
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("ordered").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (Nan::To<bool>(option).FromJust()) {
+            obj->_set.SetOrdered();
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("store").ToLocalChecked()).ToLocal(&option)) {
+            return;
         }
-        iter_obj = Nan::Call(next_func, iter, 0, 0).ToLocalChecked()->ToObject();
+        if (!option->IsUndefined()) {
+            // only a string is converted, anything else could run a toString
+            if (!option->IsString()) {
+                Nan::ThrowTypeError("Invalid store");
+                return;
+            }
+            Nan::Utf8String store(option);
+            if (strcmp(*store, "array") != 0 && strcmp(*store, "handles") != 0) {
+                Nan::ThrowTypeError("Invalid store");
+                return;
+            }
+            if (strcmp(*store, "array") == 0) {
+                obj->_store = new ArrayStore();
+            }
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("serialize").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (Nan::To<bool>(option).FromJust()) {
+#ifdef SERIALIZED_STORE_SUPPORTED
+            obj->_serialized = new SerializedStore();
+#else
+            Nan::ThrowError("Serialized values need Node.js 8 or later");
+            return;
+#endif
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("maxSize").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            if (!option->IsUint32() || Nan::To<uint32_t>(option).FromJust() == 0) {
+                Nan::ThrowTypeError("Invalid maxSize");
+                return;
+            }
+            obj->_max_size = Nan::To<uint32_t>(option).FromJust();
+            obj->_policy = EVICT_LRU;
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("policy").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            // only a string is converted, like store
+            if (!option->IsString() || obj->_max_size == 0) {
+                Nan::ThrowTypeError("Invalid policy");
+                return;
+            }
+            Nan::Utf8String policy(option);
+            if (strcmp(*policy, "lru") != 0 && strcmp(*policy, "clock") != 0) {
+                Nan::ThrowTypeError("Invalid policy");
+                return;
+            }
+            if (strcmp(*policy, "clock") == 0) {
+                obj->_policy = EVICT_CLOCK;
+            }
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("onEvict").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            if (!option->IsFunction() || obj->_max_size == 0) {
+                Nan::ThrowTypeError("Invalid onEvict");
+                return;
+            }
+            obj->_on_evict.Reset(option.As<Function>());
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("ttl").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            if (!option->IsUint32()) {
+                Nan::ThrowTypeError("Invalid ttl");
+                return;
+            }
+            obj->_ttl = Nan::To<uint32_t>(option).FromJust();
+        }
+
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("onExpire").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            if (!option->IsFunction()) {
+                Nan::ThrowTypeError("Invalid onExpire");
+                return;
+            }
+            obj->_on_expire.Reset(option.As<Function>());
+        }
+    }
+
+    if (info.Length() == 0 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        obj->_set.Reserve(capacity);
+        return;
     }
+
+    // another NodeMap is copied table and all, without rehashing a thing,
+    // and an array of pairs is set straight into the table, only anything
+    // else goes through the iterator protocol. A copy that has to
+    // serialize values can throw halfway, and a bounded one has to evict,
+    // so those go the slow way too
+    NodeMap *other = NULL;
+    if (Nan::New(_constructor)->HasInstance(info[0])) {
+        other = Nan::ObjectWrap::Unwrap<NodeMap>(info[0].As<Object>());
+    }
+
+    if (other != NULL && obj->_max_size == 0 && (obj->_serialized == NULL || other->_serialized != NULL)) {
+        // nothing already expired is copied, and the rest keep their expiry
+        if (!other->ExpireDue()) {
+            return;
+        }
+        // the copied index only works with other's hashes
+        obj->_seed = other->_seed;
+        obj->_set.CopyFrom(other->_set, EntryCopier(obj, other));
+        if (other->_wheel != NULL && !other->_wheel->Empty()) {
+            obj->_wheel = new TimerWheel(*other->_wheel);
+            obj->ScheduleExpiry(obj->_wheel->NextDue());
+        }
+        obj->_set.Reserve(capacity);
+    } else if (info[0]->IsArray()) {
+        uint32_t added = 0;
+        obj->_set.Reserve(capacity);
+        obj->SetPairs(info[0].As<Array>(), &added);
+    } else {
+        obj->_set.Reserve(capacity);
+        Populate(info.This(), info[0]);
+    }
+    obj->ReportMemory(true);
     return;
 }
 
@@ -163,22 +826,20 @@ NAN_METHOD(NodeMap::Get) {
     }
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
-    VersionedPersistentPair persistent(obj->_version, info[0]);
-
-    MapType::const_iterator itr = obj->_set.find(persistent);
-    MapType::const_iterator end = obj->_set.end();
 
-    while(itr != end && itr->IsDeleted()) {
-        itr++;
+    if (!obj->ExpireDue()) {
+        return;
     }
+    uint32_t pos = obj->LookupEntry(obj->MakeKey(info[0]));
 
-    if(itr == end || !info[0]->StrictEquals(itr->GetLocalKey())) {
+    if(pos == MapType::npos) {
         //do nothing and return undefined
         info.GetReturnValue().Set(Nan::Undefined());
         return;
     }
 
-    info.GetReturnValue().Set(itr->GetLocalValue());
+    obj->Touch(pos);
+    info.GetReturnValue().Set(obj->GetValue(pos));
     return;
 }
 
@@ -191,16 +852,13 @@ NAN_METHOD(NodeMap::Has) {
     }
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
-    VersionedPersistentPair persistent(obj->_version, info[0]);
-
-    MapType::const_iterator itr = obj->_set.find(persistent);
-    MapType::const_iterator end = obj->_set.end();
 
-    while(itr != end && itr->IsDeleted()) {
-        itr++;
+    if (!obj->ExpireDue()) {
+        return;
     }
+    uint32_t pos = obj->LookupEntry(obj->MakeKey(info[0]));
 
-    if(itr == end || !info[0]->StrictEquals(itr->GetLocalKey())) {
+    if(pos == MapType::npos) {
         //do nothing and return false
         info.GetReturnValue().Set(Nan::False());
         return;
@@ -210,6 +868,31 @@ NAN_METHOD(NodeMap::Has) {
     return;
 }
 
+// the ttl option of a set, if options is an object that has one, with
+// given set when it does. Returns false with an exception thrown if it
+// isn't a valid one
+static bool ReadTtl(Local<Value> options, uint32_t *ttl, bool *given = NULL) {
+    if (!options->IsObject()) {
+        return true;
+    }
+
+    Local<Value> option;
+    if (!Nan::Get(options.As<Object>(), Nan::New("ttl").ToLocalChecked()).ToLocal(&option)) {
+        return false;
+    }
+    if (!option->IsUndefined()) {
+        if (!option->IsUint32()) {
+            Nan::ThrowTypeError("Invalid ttl");
+            return false;
+        }
+        *ttl = Nan::To<uint32_t>(option).FromJust();
+        if (given != NULL) {
+            *given = true;
+        }
+    }
+    return true;
+}
+
 NAN_METHOD(NodeMap::Set) {
     Nan::HandleScope scope;
 
@@ -219,19 +902,14 @@ NAN_METHOD(NodeMap::Set) {
     }
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
-    VersionedPersistentPair persistent(obj->_version, info[0], info[1]);
-
-    MapType::const_iterator itr = obj->_set.find(persistent);
-    MapType::const_iterator end = obj->_set.end();
+    uint32_t ttl = obj->_ttl;
 
-    while(itr != end && itr->IsDeleted()) {
-        itr++;
+    if (info.Length() > 2 && !ReadTtl(info[2], &ttl)) {
+        return;
     }
 
-    if(itr != end && info[0]->StrictEquals(itr->GetLocalKey())) {
-        itr->ReplaceValue(obj->_version, info[1]);
-    } else {
-        obj->_set.insert(persistent);
+    if (!obj->ExpireDue() || obj->SetEntry(obj->MakeKey(info[0]), info[1], ttl).IsNothing()) {
+        return;
     }
 
     //Return this
@@ -244,6 +922,10 @@ NAN_METHOD(NodeMap::Entries) {
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
 
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
     Local<Object> iter = PairNodeIterator::New(PairNodeIterator::KEY_TYPE | PairNodeIterator::VALUE_TYPE, obj);
 
     info.GetReturnValue().Set(iter);
@@ -255,6 +937,10 @@ NAN_METHOD(NodeMap::Keys) {
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
 
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
     Local<Object> iter = PairNodeIterator::New(PairNodeIterator::KEY_TYPE, obj);
 
     info.GetReturnValue().Set(iter);
@@ -266,6 +952,10 @@ NAN_METHOD(NodeMap::Values) {
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
 
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
     Local<Object> iter = PairNodeIterator::New(PairNodeIterator::VALUE_TYPE, obj);
 
     info.GetReturnValue().Set(iter);
@@ -282,95 +972,718 @@ NAN_METHOD(NodeMap::Delete) {
     }
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
-    VersionedPersistentPair persistent(obj->_version, info[0]);
-    bool using_iterator = (obj->_iterator_count != 0);
-    bool ret;
 
-    if (using_iterator) {
-        obj->StartIterator();
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    if (obj->DeleteEntry(obj->MakeKey(info[0]))) {
+        info.GetReturnValue().Set(Nan::True());
+    } else {
+        info.GetReturnValue().Set(Nan::False());
+    }
+    return;
+}
+
+// the first count arguments as the parts of a composite key. Like a plain
+// key, none of them can be undefined or null
+static bool ReadParts(const Nan::FunctionCallbackInfo<Value> &info, Local<Value> *parts, uint32_t count) {
+    if (static_cast<uint32_t>(info.Length()) < count) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (info[i]->IsUndefined() || info[i]->IsNull()) {
+            return false;
+        }
+        parts[i] = info[i];
+    }
+    return true;
+}
+
+template <uint32_t N>
+NAN_METHOD(NodeMap::GetComposite) {
+    Nan::HandleScope scope;
+    Local<Value> parts[N];
+
+    if (!ReadParts(info, parts, N)) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    uint32_t pos = obj->LookupEntry(KeyView(parts, N, obj->_seed));
+
+    if (pos == MapType::npos) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+
+    obj->Touch(pos);
+    info.GetReturnValue().Set(obj->GetValue(pos));
+    return;
+}
+
+template <uint32_t N>
+NAN_METHOD(NodeMap::HasComposite) {
+    Nan::HandleScope scope;
+    Local<Value> parts[N];
+
+    if (!ReadParts(info, parts, N)) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    uint32_t pos = obj->LookupEntry(KeyView(parts, N, obj->_seed));
+
+    info.GetReturnValue().Set(Nan::New<Boolean>(pos != MapType::npos));
+    return;
+}
+
+template <uint32_t N>
+NAN_METHOD(NodeMap::SetComposite) {
+    Nan::HandleScope scope;
+    Local<Value> parts[N];
+
+    if (static_cast<uint32_t>(info.Length()) < N + 1 || !ReadParts(info, parts, N)) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    uint32_t ttl = obj->_ttl;
+
+    if (static_cast<uint32_t>(info.Length()) > N + 1 && !ReadTtl(info[N + 1], &ttl)) {
+        return;
+    }
+
+    if (!obj->ExpireDue() || obj->SetEntry(KeyView(parts, N, obj->_seed), info[N], ttl).IsNothing()) {
+        return;
     }
 
-    MapType::const_iterator itr = obj->_set.find(persistent);
-    MapType::const_iterator end = obj->_set.end();
+    info.GetReturnValue().Set(info.This());
+    return;
+}
+
+template <uint32_t N>
+NAN_METHOD(NodeMap::DeleteComposite) {
+    Nan::HandleScope scope;
+    Local<Value> parts[N];
 
-    while(itr != end && itr->IsDeleted()) {
-        itr++;
+    if (!ReadParts(info, parts, N)) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
     }
 
-    ret = (itr != end && info[0]->StrictEquals(itr->GetLocalKey()));
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
 
-    if (using_iterator) {
-        if (ret) {
-            itr->Delete();
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::New<Boolean>(obj->DeleteEntry(KeyView(parts, N, obj->_seed))));
+    return;
+}
+
+NAN_METHOD(NodeMap::GetOrSet) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 2 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    uint32_t ttl = obj->_ttl;
+
+    if (info.Length() > 2 && !ReadTtl(info[2], &ttl)) {
+        return;
+    }
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    KeyView key = obj->MakeKey(info[0]);
+    MapType::InsertHint hint;
+    uint32_t pos = obj->LookupEntry(key, &hint);
+
+    if (pos != MapType::npos) {
+        obj->Touch(pos);
+        info.GetReturnValue().Set(obj->GetValue(pos));
+        return;
+    }
+
+    Local<Value> value = info[1];
+    if (value->IsFunction()) {
+        Local<Value> argv[1] = {info[0]};
+        if (!Nan::Call(value.As<Function>(), Nan::GetCurrentContext()->Global(), 1, argv).ToLocal(&value)) {
+            return;
         }
-        obj->StopIterator();
-    } else {
-        if (ret) {
-            obj->_set.erase(itr);
+        // the function could have changed the map
+        pos = obj->FindEntry(key, &hint);
+    }
+
+    if (obj->SetFoundEntry(key, pos, hint, value, NULL, &ttl).IsNothing()) {
+        return;
+    }
+
+    info.GetReturnValue().Set(value);
+    return;
+}
+
+NAN_METHOD(NodeMap::Update) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 2 || info[0]->IsUndefined() || info[0]->IsNull() || !info[1]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    uint32_t ttl = 0;
+    bool has_ttl = false;
+
+    // an entry keeps its expiry unless it's given a new one
+    if (info.Length() > 2 && !ReadTtl(info[2], &ttl, &has_ttl)) {
+        return;
+    }
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    KeyView key = obj->MakeKey(info[0]);
+    MapType::InsertHint hint;
+    uint32_t pos = obj->LookupEntry(key, &hint);
+    Local<Value> value = pos == MapType::npos ? Nan::Undefined().As<Value>() : obj->GetValue(pos);
+
+    if (value.IsEmpty()) {
+        return;
+    }
+
+    Local<Value> argv[2] = {value, info[0]};
+    if (!Nan::Call(info[1].As<Function>(), Nan::GetCurrentContext()->Global(), 2, argv).ToLocal(&value)) {
+        return;
+    }
+
+    // the function could have changed the map. An entry that is still
+    // there with the same key is only checked, a missing one is looked
+    // for again
+    if (pos == MapType::npos || pos >= obj->_set.End() || obj->_set.At(pos).IsHole()
+        || obj->_set.At(pos).GetHash() != key.GetHash() || !key.Matches(obj->GetKey(pos))) {
+        pos = obj->FindEntry(key, &hint);
+    }
+
+    if (obj->SetFoundEntry(key, pos, hint, value, NULL, has_ttl ? &ttl : NULL).IsNothing()) {
+        return;
+    }
+
+    info.GetReturnValue().Set(value);
+    return;
+}
+
+NAN_METHOD(NodeMap::Increment) {
+    Nan::HandleScope scope;
+    double delta = 1;
+
+    if (info.Length() < 1 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+    if (info.Length() > 1 && !info[1]->IsUndefined()) {
+        if (!info[1]->IsNumber()) {
+            Nan::ThrowTypeError("Wrong arguments");
+            return;
         }
+        delta = info[1].As<Number>()->Value();
     }
 
-    if (ret) {
-        info.GetReturnValue().Set(Nan::True());
-    } else {
-        info.GetReturnValue().Set(Nan::False());
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    uint32_t ttl = 0;
+    bool has_ttl = false;
+
+    // like update, a count keeps its expiry unless it's given a new one
+    if (info.Length() > 2 && !ReadTtl(info[2], &ttl, &has_ttl)) {
+        return;
     }
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    KeyView key = obj->MakeKey(info[0]);
+    MapType::InsertHint hint;
+    uint32_t pos = obj->LookupEntry(key, &hint);
+    double number = 0;
+
+    if (pos != MapType::npos && !obj->GetNumber(pos, &number)) {
+        Nan::ThrowTypeError("Value is not a number");
+        return;
+    }
+    number += delta;
+
+    if (obj->SetFoundEntry(key, pos, hint, Local<Value>(), &number, has_ttl ? &ttl : NULL).IsNothing()) {
+        return;
+    }
+
+    info.GetReturnValue().Set(number);
     return;
 }
 
-NAN_METHOD(NodeMap::Clear) {
+NAN_METHOD(NodeMap::Clone) {
+    Nan::HandleScope scope;
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    Local<Object> handle;
+    NodeMap *copy = NewInstance(&handle);
+    if (copy == NULL) {
+        return;
+    }
+
+    copy->CopyOptions(obj);
+    copy->_set.CopyFrom(obj->_set, EntryCopier(copy, obj));
+    copy->_newest = obj->_newest;
+    copy->_oldest = obj->_oldest;
+    copy->_clock_hand = obj->_clock_hand;
+    if (obj->_wheel != NULL && !obj->_wheel->Empty()) {
+        copy->_wheel = new TimerWheel(*obj->_wheel);
+        copy->ScheduleExpiry(copy->_wheel->NextDue());
+    }
+    copy->ReportMemory(true);
+
+    info.GetReturnValue().Set(handle);
+    return;
+}
+
+NAN_METHOD(NodeMap::Merge) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !Nan::New(_constructor)->HasInstance(info[0])) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    NodeMap *other = Nan::ObjectWrap::Unwrap<NodeMap>(info[0].As<Object>());
+    bool overwrite = true;
+
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        Local<Value> option;
+        if (!Nan::Get(info[1].As<Object>(), Nan::New("overwrite").ToLocalChecked()).ToLocal(&option)) {
+            return;
+        }
+        if (!option->IsUndefined()) {
+            overwrite = Nan::To<bool>(option).FromJust();
+        }
+    }
+
+    if (!obj->ExpireDue() || !other->ExpireDue()) {
+        return;
+    }
+
+    // walked like forEach walks it, so other isn't compacted and entries
+    // set while this runs aren't merged, whatever callbacks do to it
+    uint32_t version = other->StartIterator();
+    uint32_t added = 0;
+    bool threw = false;
+
+    for (uint32_t pos = 0; pos < other->_set.End(); pos++) {
+        if (!other->IsValid(pos, version)) {
+            continue;
+        }
+
+        Nan::HandleScope element_scope;
+        KeyView key = other->KeyAt(pos, obj->_seed);
+        MapType::InsertHint hint;
+        uint32_t found = obj->FindEntry(key, &hint);
+
+        if (found != MapType::npos && !overwrite) {
+            continue;
+        }
+
+        Nan::Maybe<bool> set = obj->SetFoundEntry(key, found, hint, other->GetValue(pos), NULL, &obj->_ttl);
+        if (set.IsNothing()) {
+            threw = true;
+            break;
+        }
+        if (set.FromJust()) {
+            added++;
+        }
+    }
+    other->StopIterator();
+
+    if (threw) {
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::New<Integer>(added));
+    return;
+}
+
+NAN_METHOD(NodeMap::Filter) {
     Nan::HandleScope scope;
 
+    if (info.Length() < 1 || !info[0]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    Local<Function> cb = info[0].As<Function>();
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    Local<Object> handle;
+    NodeMap *result = NewInstance(&handle);
+    if (result == NULL) {
+        return;
+    }
+    result->CopyOptions(obj);
+
+    const unsigned argc = 3;
+    Local<Value> argv[argc];
+    argv[2] = info.This();
+
+    uint64_t now = obj->_wheel != NULL ? uv_now(Nan::GetCurrentEventLoop()) : 0;
+    uint32_t version = obj->StartIterator();
+    bool threw = false;
+
+    // the callback can add entries, so the end is checked every time
+    for (uint32_t pos = 0; pos < obj->_set.End(); pos++) {
+        if (!obj->IsValid(pos, version)) {
+            continue;
+        }
+
+        Nan::HandleScope element_scope;
+        Local<Value> keep;
+        argv[0] = obj->GetValue(pos);
+        argv[1] = obj->GetKey(pos);
+        if (!Nan::Call(cb, Nan::GetCurrentContext()->Global(), argc, argv).ToLocal(&keep)) {
+            threw = true;
+            break;
+        }
+        // or delete the one it was just given
+        if (!Nan::To<bool>(keep).FromJust() || !obj->IsValid(pos, version)) {
+            continue;
+        }
+
+        uint64_t expires = obj->_wheel != NULL ? obj->_wheel->Expires(pos) : 0;
+        uint32_t ttl = expires == 0 ? 0 : expires > now ? static_cast<uint32_t>(expires - now) : 1;
+        if (result->SetEntry(obj->KeyAt(pos, result->_seed), argv[0], ttl).IsNothing()) {
+            threw = true;
+            break;
+        }
+    }
+    obj->StopIterator();
+
+    if (threw) {
+        return;
+    }
+
+    result->ReportMemory(true);
+    info.GetReturnValue().Set(handle);
+    return;
+}
+
+void NodeMap::ToArray(const Nan::FunctionCallbackInfo<Value> &info, int type) {
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
-    bool using_iterator = (obj->_iterator_count != 0);
 
-    if (using_iterator) {
-        obj->StartIterator();
+    if (!obj->ExpireDue()) {
+        return;
     }
 
-    for(MapType::const_iterator itr = obj->_set.begin(); itr != obj->_set.end(); ) {
-        if (using_iterator) {
-            itr->Delete();
-            itr++;
+    // nothing in here calls into JS, so the map can't change on the way
+    Local<Array> results = Nan::New<Array>(static_cast<int>(obj->_set.Size()));
+    uint32_t end = obj->_set.End();
+    uint32_t i = 0;
+
+    for (uint32_t pos = 0; pos < end; pos++) {
+        if (obj->_set.At(pos).IsHole()) {
+            continue;
+        }
+
+        Nan::HandleScope element_scope;
+        if (type == PairNodeIterator::KEY_TYPE) {
+            Nan::Set(results, i++, obj->GetKey(pos));
+        } else if (type == PairNodeIterator::VALUE_TYPE) {
+            Nan::Set(results, i++, obj->GetValue(pos));
         } else {
-            itr = obj->_set.erase(itr);
+            Local<Array> pair = Nan::New<Array>(2);
+            Nan::Set(pair, 0, obj->GetKey(pos));
+            Nan::Set(pair, 1, obj->GetValue(pos));
+            Nan::Set(results, i++, pair);
         }
     }
 
-    if (using_iterator) {
-        obj->StopIterator();
+    info.GetReturnValue().Set(results);
+}
+
+NAN_METHOD(NodeMap::KeysArray) {
+    Nan::HandleScope scope;
+    ToArray(info, PairNodeIterator::KEY_TYPE);
+}
+
+NAN_METHOD(NodeMap::ValuesArray) {
+    Nan::HandleScope scope;
+    ToArray(info, PairNodeIterator::VALUE_TYPE);
+}
+
+NAN_METHOD(NodeMap::EntriesArray) {
+    Nan::HandleScope scope;
+    ToArray(info, PairNodeIterator::KEY_TYPE | PairNodeIterator::VALUE_TYPE);
+}
+
+NAN_METHOD(NodeMap::Clear) {
+    Nan::HandleScope scope;
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    // running iterators are past the end of the emptied table, or only
+    // find entries newer than their version from here on
+    obj->_set.Clear();
+    if (obj->_store != NULL) {
+        obj->_store->Clear();
+    }
+    if (obj->_serialized != NULL) {
+        obj->_serialized->Clear();
+    }
+    if (obj->_wheel != NULL) {
+        obj->_wheel->Clear();
     }
+    std::vector<double>().swap(obj->_numbers);
+    obj->_newest = VersionedPersistentPair::kNoLink;
+    obj->_oldest = VersionedPersistentPair::kNoLink;
+    obj->_clock_hand = 0;
+    obj->ReportMemory(true);
 
     info.GetReturnValue().Set(Nan::Undefined());
     return;
 }
 
-NAN_GETTER(NodeMap::Size) {
+NAN_METHOD(NodeMap::Reserve) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsUint32()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    obj->_set.Reserve(Nan::To<uint32_t>(info[0]).FromJust());
+    obj->ReportMemory(true);
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(NodeMap::Stats) {
+    Nan::HandleScope scope;
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    FlatTableStats stats;
+    obj->_set.GetStats(&stats);
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    double size = static_cast<double>(obj->_set.Size());
+
+    Nan::Set(result, Nan::New("size").ToLocalChecked(), Nan::New<v8::Number>(size));
+    Nan::Set(result, Nan::New("capacity").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(stats.capacity)));
+    Nan::Set(result, Nan::New("loadFactor").ToLocalChecked(), Nan::New<v8::Number>(stats.capacity == 0 ? 0 : size / stats.capacity));
+    Nan::Set(result, Nan::New("maxProbe").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(stats.max_probe)));
+    Nan::Set(result, Nan::New("averageProbe").ToLocalChecked(), Nan::New<v8::Number>(stats.average_probe));
+    Nan::Set(result, Nan::New("holes").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(stats.holes)));
+    Nan::Set(result, Nan::New("deleted").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(stats.deleted)));
+    Nan::Set(result, Nan::New("iterators").ToLocalChecked(), Nan::New<v8::Number>(obj->_iterator_count));
+    Nan::Set(result, Nan::New("rehashes").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(stats.rehashes)));
+    Nan::Set(result, Nan::New("migrating").ToLocalChecked(), Nan::New<v8::Boolean>(stats.migrating));
+    Nan::Set(result, Nan::New("nativeBytes").ToLocalChecked(), Nan::New<v8::Number>(static_cast<double>(obj->NativeBytes())));
+
+    if (obj->_counters != NULL) {
+        v8::Local<v8::Object> counters = Nan::New<v8::Object>();
+        Nan::Set(counters, Nan::New("hits").ToLocalChecked(), Nan::New<v8::Number>(obj->_counters->hits));
+        Nan::Set(counters, Nan::New("misses").ToLocalChecked(), Nan::New<v8::Number>(obj->_counters->misses));
+        Nan::Set(counters, Nan::New("inserts").ToLocalChecked(), Nan::New<v8::Number>(obj->_counters->inserts));
+        Nan::Set(counters, Nan::New("deletes").ToLocalChecked(), Nan::New<v8::Number>(obj->_counters->deletes));
+        Nan::Set(counters, Nan::New("evictions").ToLocalChecked(), Nan::New<v8::Number>(obj->_counters->evictions));
+        Nan::Set(counters, Nan::New("expirations").ToLocalChecked(), Nan::New<v8::Number>(obj->_counters->expirations));
+        Nan::Set(result, Nan::New("counters").ToLocalChecked(), counters);
+    } else {
+        Nan::Set(result, Nan::New("counters").ToLocalChecked(), Nan::Null());
+    }
+
+    info.GetReturnValue().Set(result);
+    return;
+}
+
+NAN_METHOD(NodeMap::MemoryUsage) {
+    Nan::HandleScope scope;
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    info.GetReturnValue().Set(Nan::New<v8::Number>(static_cast<double>(obj->NativeBytes())));
+    return;
+}
+
+NAN_METHOD(NodeMap::CountOperations) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsBoolean()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
-    uint32_t size = 0;
-    if (obj->_iterator_count == 0) {
-        size = obj->_set.size();
-        info.GetReturnValue().Set(Nan::New<Integer>(size));
+
+    delete obj->_counters;
+    obj->_counters = info[0]->IsTrue() ? new OperationCounters() : NULL;
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(NodeMap::ShrinkToFit) {
+    Nan::HandleScope scope;
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (obj->_iterator_count == 0 && obj->_set.IsOrdered()) {
+        obj->Compact();
+    }
+    obj->_set.ShrinkToFit();
+    obj->TruncateStores();
+    obj->ReportMemory(true);
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(NodeMap::SaveSnapshot) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsString()) {
+        Nan::ThrowTypeError("Wrong arguments");
         return;
     }
 
-    MapType::const_iterator itr = obj->_set.begin();
-    MapType::const_iterator end = obj->_set.end();
-    for (; itr != end; itr++) {
-        if (itr->IsValid(obj->_version)) {
-            size += 1;
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    Nan::Utf8String path(info[0]);
+    SnapshotWriter writer(std::string(*path, path.length()));
+
+    if (!writer.Open()) {
+        Nan::ThrowError(writer.Error().c_str());
+        return;
+    }
+
+    // serializing can run getters, so the end is checked every time. On
+    // any error the writer drops its temporary file
+    uint32_t version = obj->StartIterator();
+    bool written = true;
+    for (uint32_t pos = 0; written && pos < obj->_set.End(); pos++) {
+        if (!obj->IsValid(pos, version)) {
+            continue;
+        }
+        Nan::HandleScope entry_scope;
+        SharedKey key(obj->GetKey(pos));
+        SerializedValue value;
+
+        if (!key.IsValid()) {
+            Nan::ThrowTypeError("Snapshot keys must be numbers or strings");
+            written = false;
+        } else if (!SerializedStore::Serialize(obj->GetValue(pos), &value)) {
+            written = false;
+        } else {
+            if (!writer.Add(key, value)) {
+                Nan::ThrowError(writer.Error().c_str());
+                written = false;
+            }
+            free(value.data);
         }
     }
+    obj->StopIterator();
+
+    if (written && !writer.Finish()) {
+        Nan::ThrowError(writer.Error().c_str());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(NodeMap::OpenSnapshot) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsString()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    Nan::Utf8String path(info[0]);
+    std::string error;
+    Snapshot *snapshot = Snapshot::Open(std::string(*path, path.length()), &error);
+
+    if (snapshot == NULL) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+
+    info.GetReturnValue().Set(SnapshotMap::New(snapshot));
+    return;
+}
+
+NAN_GETTER(NodeMap::Size) {
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
+    uint32_t size = obj->_set.Size();
 
     info.GetReturnValue().Set(Nan::New<Integer>(size));
     return;
 }
 
+NAN_GETTER(NodeMap::SerializedBytes) {
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+    size_t bytes = obj->_serialized != NULL ? obj->_serialized->Bytes() : 0;
+
+    info.GetReturnValue().Set(Nan::New<Number>(static_cast<double>(bytes)));
+    return;
+}
+
 NAN_METHOD(NodeMap::ForEach) {
     Nan::HandleScope scope;
 
     NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
 
+    if (!obj->ExpireDue()) {
+        return;
+    }
+
     if (info.Length() < 1 || !info[0]->IsFunction()) {
         Nan::ThrowTypeError("Wrong arguments");
         return;
@@ -389,16 +1702,14 @@ NAN_METHOD(NodeMap::ForEach) {
     argv[2] = info.This();
 
     uint32_t version = obj->StartIterator();
-    MapType::const_iterator itr = obj->_set.begin();
-    MapType::const_iterator end = obj->_set.end();
 
-    while (itr != end) {
-        if (itr->IsValid(version)) {
-            argv[0] = itr->GetLocalValue();
-            argv[1] = itr->GetLocalKey();
+    // the callback can add entries, so the end is checked every time
+    for (uint32_t pos = 0; pos < obj->_set.End(); pos++) {
+        if (obj->IsValid(pos, version)) {
+            argv[0] = obj->GetValue(pos);
+            argv[1] = obj->GetKey(pos);
             cb->Call(ctx, argc, argv);
         }
-        itr++;
     }
     obj->StopIterator();
 
@@ -407,11 +1718,204 @@ NAN_METHOD(NodeMap::ForEach) {
 }
 
 
+// the batch methods below do a whole array of operations per call, with a
+// handle scope per element so that a big batch doesn't pile up handles
+
+NAN_METHOD(NodeMap::SetMany) {
+    Nan::HandleScope scope;
+
+    bool pairs = info.Length() < 2 || info[1]->IsUndefined();
+    if (info.Length() < 1 || !info[0]->IsArray() || (!pairs && !info[1]->IsArray())) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    Local<Array> keys = info[0].As<Array>();
+    Local<Array> values;
+    uint32_t length = keys->Length();
+    uint32_t added = 0;
+
+    if (pairs) {
+        if (obj->SetPairs(keys, &added)) {
+            info.GetReturnValue().Set(Nan::New<Integer>(added));
+        }
+        return;
+    }
+
+    values = info[1].As<Array>();
+    if (values->Length() != length) {
+        Nan::ThrowTypeError("Keys and values differ in length");
+        return;
+    }
+
+    // make room for every key up front, instead of growing along the way
+    obj->_set.Reserve(obj->_set.Size() + length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        Nan::HandleScope element_scope;
+        Local<Value> key;
+        Local<Value> value;
+
+        if (!Nan::Get(keys, i).ToLocal(&key) || !Nan::Get(values, i).ToLocal(&value)) {
+            return;
+        }
+        if (key->IsUndefined() || key->IsNull()) {
+            Nan::ThrowTypeError("Wrong arguments");
+            return;
+        }
+        Nan::Maybe<bool> set = obj->SetEntry(obj->MakeKey(key), value, obj->_ttl);
+        if (set.IsNothing()) {
+            return;
+        }
+        if (set.FromJust()) {
+            added++;
+        }
+    }
+
+    info.GetReturnValue().Set(Nan::New<Integer>(added));
+    return;
+}
+
+NAN_METHOD(NodeMap::GetMany) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsArray()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    Local<Array> keys = info[0].As<Array>();
+    uint32_t length = keys->Length();
+    Local<Array> results = Nan::New<Array>(length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        Nan::HandleScope element_scope;
+        Local<Value> key;
+
+        if (!Nan::Get(keys, i).ToLocal(&key)) {
+            return;
+        }
+        if (key->IsUndefined() || key->IsNull()) {
+            Nan::ThrowTypeError("Wrong arguments");
+            return;
+        }
+
+        uint32_t pos = obj->LookupEntry(obj->MakeKey(key));
+        if (pos == MapType::npos) {
+            Nan::Set(results, i, Nan::Undefined());
+        } else {
+            obj->Touch(pos);
+            Nan::Set(results, i, obj->GetValue(pos));
+        }
+    }
+
+    info.GetReturnValue().Set(results);
+    return;
+}
+
+NAN_METHOD(NodeMap::HasMany) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsArray()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    Local<Array> keys = info[0].As<Array>();
+    uint32_t length = keys->Length();
+    Local<Array> results = Nan::New<Array>(length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        Nan::HandleScope element_scope;
+        Local<Value> key;
+
+        if (!Nan::Get(keys, i).ToLocal(&key)) {
+            return;
+        }
+        if (key->IsUndefined() || key->IsNull()) {
+            Nan::ThrowTypeError("Wrong arguments");
+            return;
+        }
+
+        if (obj->LookupEntry(obj->MakeKey(key)) == MapType::npos) {
+            Nan::Set(results, i, Nan::False());
+        } else {
+            Nan::Set(results, i, Nan::True());
+        }
+    }
+
+    info.GetReturnValue().Set(results);
+    return;
+}
+
+NAN_METHOD(NodeMap::DeleteMany) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsArray()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeMap *obj = Nan::ObjectWrap::Unwrap<NodeMap>(info.This());
+
+    if (!obj->ExpireDue()) {
+        return;
+    }
+    Local<Array> keys = info[0].As<Array>();
+    uint32_t length = keys->Length();
+    uint32_t deleted = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        Nan::HandleScope element_scope;
+        Local<Value> key;
+
+        if (!Nan::Get(keys, i).ToLocal(&key)) {
+            return;
+        }
+        if (key->IsUndefined() || key->IsNull()) {
+            Nan::ThrowTypeError("Wrong arguments");
+            return;
+        }
+
+        if (obj->DeleteEntry(obj->MakeKey(key))) {
+            deleted++;
+        }
+    }
+
+    info.GetReturnValue().Set(Nan::New<Integer>(deleted));
+    return;
+}
+
 extern "C" void
 init (Local<Object> target) {
     Nan::HandleScope scope;
 
     NodeMap::init(target);
+    NumberMap::init(target);
+    StringMap::init(target);
+    NodeSet::init(target);
+#ifdef SERIALIZED_STORE_SUPPORTED
+    SharedMap::init(target);
+    SnapshotMap::init(target);
+#endif
+    PairNodeIterator::init(target);
 }
 
-NODE_MODULE(map, init);
+// the module can be loaded in worker threads too, each one gets its own
+// set of classes
+NAN_MODULE_WORKER_ENABLED(map, init)
@@ -3,45 +3,246 @@
 
 #include <string>
 #include <iostream>
-#include <unordered_set>
+#include <vector>
 #include <node.h>
 #include <nan.h>
+#include <uv.h>
+#include "array_store.h"
+#include "flat_table.h"
+#include "iterable_map.h"
+#include "serialized_store.h"
+#include "timer_wheel.h"
 #include "v8_value_hasher.h"
 
-typedef std::unordered_set<VersionedPersistentPair, v8_value_hash, v8_value_equal_to> MapType;
+typedef FlatTable<VersionedPersistentPair, v8_value_hash> MapType;
 
-class NodeMap : public Nan::ObjectWrap {
+class NodeMap : public IterableMap {
 public:
     static void init(v8::Local<v8::Object> target);
 
-    uint32_t StartIterator();
-    void StopIterator();
-    MapType::const_iterator GetBegin();
-    MapType::const_iterator GetEnd();
+    uint32_t GetEnd();
+    bool IsValid(uint32_t pos, uint32_t version);
+    v8::Local<v8::Value> GetKey(uint32_t pos);
+    v8::Local<v8::Value> GetValue(uint32_t pos);
 
 private:
+    // how a bounded map picks the entry to make room with
+    enum EvictionPolicy {
+        EVICT_NONE,
+        EVICT_LRU,
+        EVICT_CLOCK
+    };
+
+    // what map.countOperations(true) has the map count, from then on
+    struct OperationCounters {
+        OperationCounters() : hits(0), misses(0), inserts(0), deletes(0), evictions(0), expirations(0) {}
+
+        double hits;
+        double misses;
+        double inserts;
+        double deletes;
+        double evictions;
+        double expirations;
+    };
+
     NodeMap();
     ~NodeMap();
 
+    // one per isolate, like PairNodeIterator's
+    static thread_local Nan::Persistent<v8::FunctionTemplate> _constructor;
+
     MapType _set;
-    // each time an iterator starts, the _version gets incremented
-    // it is used so that items added after an iterator starts are
-    // not visited in the iterator
-    uint32_t _version;
-    // we keep track of how many running iterators there are so that
-    // we can clean up when the last iterator is done
-    uint32_t _iterator_count;
-    // we store the load factor here before the first iterator starts
-    // and then set the load factor to infinity so that rehashes of
-    // the set don't happen (from inserts that happen inside an iterator)
-    // once the last iterator finishes, the load factor is reset, and
-    // a rehash might happen
-    float _old_load_factor;
-
-    // new NodeMap()
+    // what the keys are hashed with, the process' seed until the table
+    // gets flooded
+    HashSeed _seed;
+    // where the keys and values are when the map was made with
+    // {store: 'array'}, otherwise NULL and they are in the entries
+    ArrayStore *_store;
+    // the values when the map was made with {serialize: true}, otherwise
+    // NULL
+    SerializedStore *_serialized;
+
+    // a map made with {maxSize: n} never holds more than _max_size entries,
+    // setting a new key past that evicts one first. 0 if it's unbounded
+    uint32_t _max_size;
+    EvictionPolicy _policy;
+    // the ends of an LRU map's recency list, linked through the entries
+    uint32_t _newest;
+    uint32_t _oldest;
+    // where a CLOCK map looks for its next victim
+    uint32_t _clock_hand;
+    // called with (value, key, map) for every evicted entry, if set
+    Nan::Persistent<v8::Function> _on_evict;
+
+    // when the entries set with a ttl expire, NULL until there is one
+    TimerWheel *_wheel;
+    // the ttl in milliseconds of a set that doesn't give one, 0 for none
+    uint32_t _ttl;
+    // called with (value, key, map) for every expired entry, if set
+    Nan::Persistent<v8::Function> _on_expire;
+    // wakes the map up to expire entries nobody looks at, so they don't
+    // sit there until the next access. Unref'd, it never keeps the
+    // process alive
+    uv_timer_t *_expiry_timer;
+    uint64_t _expiry_due;
+    Nan::AsyncResource *_expiry_resource;
+
+    // NULL unless operations are being counted
+    OperationCounters *_counters;
+
+    // the values map.increment() keeps as native doubles, by position. Only
+    // a map that keeps its values in handles does, and then an entry
+    // without a value handle has its value here
+    std::vector<double> _numbers;
+
+    // native memory V8 was last told about
+    size_t _reported_bytes;
+    static const size_t kMemoryReportStep = 64 * 1024;
+
+    // fills in a copied entry for MapType::CopyFrom, the maps can keep
+    // their keys and values differently
+    struct EntryCopier {
+        EntryCopier(NodeMap *to, NodeMap *from) : _to(to), _from(from) {}
+
+        void operator()(VersionedPersistentPair &entry, const VersionedPersistentPair &other, uint32_t pos) const {
+            Nan::HandleScope scope;
+            v8::Local<v8::Value> value;
+
+            // only ever copied into a serialized map from another one
+            if (_to->_serialized != NULL) {
+                _to->_serialized->Copy(pos, *_from->_serialized, pos);
+            } else {
+                value = _from->GetValue(pos);
+            }
+            _to->AssignEntry(pos, KeyView(_from->GetKey(pos), other.GetHash()), value);
+            // a clone of a bounded map keeps its recency too
+            if (_to->_policy != EVICT_NONE) {
+                entry.SetOlder(other.GetOlder());
+                entry.SetNewer(other.GetNewer());
+            }
+        }
+
+        NodeMap *_to;
+        NodeMap *_from;
+    };
+
+    // hashes every key again with a new seed for MapType::Reseed
+    struct EntryRehasher {
+        explicit EntryRehasher(NodeMap *map) : _map(map) {}
+
+        void operator()(VersionedPersistentPair &entry, uint32_t pos) const {
+            bool composite = (entry.GetHash() & kCompositeHashBit) != 0;
+            entry.SetHash(v8_stored_key_hash(_map->GetKey(pos), composite, _map->_seed));
+        }
+
+        NodeMap *_map;
+    };
+
+    // moves the stores along with the entries for MapType::Compact
+    struct StoreMover {
+        explicit StoreMover(NodeMap *map) : _map(map) {}
+
+        void operator()(uint32_t to, uint32_t from) const {
+            if (_map->_policy == EVICT_LRU) {
+                _map->Relink(to);
+            }
+            if (_map->_store != NULL) {
+                _map->_store->Move(to, from);
+            }
+            if (_map->_serialized != NULL) {
+                _map->_serialized->Move(to, from);
+            }
+            if (_map->_wheel != NULL) {
+                _map->_wheel->Move(to, from);
+            }
+            if (from < _map->_numbers.size()) {
+                _map->_numbers[to] = _map->_numbers[from];
+            }
+        }
+
+        NodeMap *_map;
+    };
+
+    // the position of key's entry, or MapType::npos. With a hint, also
+    // where SetFoundEntry can insert key without looking for it again
+    uint32_t FindEntry(const KeyView &key);
+    uint32_t FindEntry(const KeyView &key, MapType::InsertHint *hint);
+    // FindEntry for a get or has, counted as a hit or a miss
+    uint32_t LookupEntry(const KeyView &key, MapType::InsertHint *hint = NULL);
+    // the key as a lookup, hashed with the map's seed
+    KeyView MakeKey(v8::Local<v8::Value> key) const {
+        return KeyView(key, this->_seed);
+    }
+    // the key at pos as a lookup in a map hashed with seed, keeping its
+    // hash when the seeds are the same
+    KeyView KeyAt(uint32_t pos, const HashSeed &seed);
+    // moves the table to a new seed once someone managed to flood it
+    void Reseed();
+    // returns true if key wasn't in the map before, or nothing if value
+    // had to be serialized and couldn't be. A ttl of 0 never expires
+    Nan::Maybe<bool> SetEntry(const KeyView &key, v8::Local<v8::Value> value, uint32_t ttl);
+    // SetEntry once FindEntry(key, &hint) returned pos. If number is set
+    // it's the value, kept as a native double by a map that can. Without
+    // a ttl, an entry that was there keeps its expiry and a new one gets
+    // the map's ttl
+    Nan::Maybe<bool> SetFoundEntry(const KeyView &key, uint32_t pos, MapType::InsertHint hint,
+                                   v8::Local<v8::Value> value, const double *number, const uint32_t *ttl);
+    // whether the value at pos is a number, and which
+    bool GetNumber(uint32_t pos, double *number);
+    // fill in the entry at pos, wherever the map keeps its keys and values
+    void AssignEntry(uint32_t pos, const KeyView &key, v8::Local<v8::Value> value);
+    void ReplaceEntry(uint32_t pos, v8::Local<v8::Value> value);
+    // returns true if there was an entry to delete
+    bool DeleteEntry(const KeyView &key);
+    void ErasePosition(uint32_t pos);
+    // recency bookkeeping of a bounded map, a no-op for any other
+    void Touch(uint32_t pos);
+    void LinkNewest(uint32_t pos);
+    void Unlink(uint32_t pos);
+    // points the neighbours of the entry at pos back at it once it moved
+    void Relink(uint32_t pos);
+    // the position of the entry to evict next
+    uint32_t NextVictim();
+    // drops one entry to make room for a new one, handing out its key and
+    // value if there's an onEvict callback for them
+    void Evict(v8::Local<v8::Value> *key, v8::Local<v8::Value> *value);
+    // drops every entry whose ttl has run out, costing about as much as
+    // there are of them. Every operation starts with this, so no expired
+    // entry is ever seen. Returns false if the onExpire callback threw
+    bool ExpireDue() {
+        return this->_wheel == NULL || this->_wheel->Empty() || this->ExpireEntries(false);
+    }
+    bool ExpireEntries(bool from_timer);
+    void ScheduleExpiry(uint64_t due);
+    static void OnExpiryTimer(uv_timer_t *timer);
+    // compacts an ordered table when it has enough holes and nothing is
+    // iterating over it
+    void CompactIfIdle();
+    void Compact();
+    void TruncateStores();
+    // all the native memory the map holds, itself included
+    size_t NativeBytes() const;
+    // tells V8 how much the native memory changed since it was last told,
+    // so the GC sees a big map as big. Small changes wait until they add
+    // up to kMemoryReportStep, unless force is set
+    void ReportMemory(bool force);
+    // sets an array of [key, value] pairs, returns false if it threw
+    bool SetPairs(v8::Local<v8::Array> pairs, uint32_t *added);
+    // a new, empty NodeMap, or NULL with an exception thrown
+    static NodeMap *NewInstance(v8::Local<v8::Object> *handle);
+    // makes this empty map work like from: its stores, bounds, ttl and
+    // callbacks, and its seed
+    void CopyOptions(NodeMap *from);
+    // an array of the keys, values or [key, value] pairs, for the
+    // PairNodeIterator type
+    static void ToArray(const Nan::FunctionCallbackInfo<v8::Value> &info, int type);
+
+    // new NodeMap([iterable], [{capacity: number, ordered: boolean, store: 'handles' | 'array', serialize: boolean,
+    //                          maxSize: number, policy: 'lru' | 'clock', onEvict: function (value, key, map) {...},
+    //                          ttl: milliseconds, onExpire: function (value, key, map) {...}}])
     static NAN_METHOD(Constructor);
 
-    // map.set(key, value) : map
+    // map.set(key, value, [{ttl: milliseconds}]) : map
     static NAN_METHOD(Set);
 
     // map.get(key) : value
@@ -62,14 +263,108 @@ private:
     // map.size : number of elements
     static NAN_GETTER(Size);
 
+    // map.serializedBytes : bytes of native memory holding serialized values
+    static NAN_GETTER(SerializedBytes);
+
     // map.delete(key) : boolean
     static NAN_METHOD(Delete);
 
+    // map.get2(a, b) / map.get3(a, b, c) and so on for has, set and
+    // delete: the map api with a composite key, whose parts are compared
+    // one by one like separate keys. The key is kept, and iterated over,
+    // as a frozen array of the parts, but lookups never make one
+    template <uint32_t N>
+    static NAN_METHOD(GetComposite);
+    template <uint32_t N>
+    static NAN_METHOD(HasComposite);
+    // map.set2(a, b, value, {ttl}) : map
+    template <uint32_t N>
+    static NAN_METHOD(SetComposite);
+    template <uint32_t N>
+    static NAN_METHOD(DeleteComposite);
+
+    // map.getOrSet(key, value | function (key) {...}, [{ttl: milliseconds}]) : value
+    // the value of key, after setting it to value, or what the function
+    // returns, if it isn't there
+    static NAN_METHOD(GetOrSet);
+
+    // map.update(key, function (value, key) {...}, [{ttl: milliseconds}]) : value
+    // sets key to what the function returns for its value, undefined if
+    // it isn't there
+    static NAN_METHOD(Update);
+
+    // map.increment(key, [delta]) : number
+    // adds delta, 1 by default, to the number at key, 0 if it isn't there
+    static NAN_METHOD(Increment);
+
+    // map.clone() : map
+    // a copy with the same options, entries, recency and expiry times. The
+    // table is copied as it is, nothing is hashed again
+    static NAN_METHOD(Clone);
+
+    // map.merge(other, [{overwrite: boolean}]) : number of keys added
+    // sets every entry of another NodeMap, keeping the ones already there
+    // unless overwrite, true by default, is set
+    static NAN_METHOD(Merge);
+
+    // map.filter(function (value, key, map) {...}) : map
+    // a map with the options of this one and the entries the function
+    // returns something truthy for, with the time they had left to live
+    static NAN_METHOD(Filter);
+
+    // map.keysArray() / map.valuesArray() / map.entriesArray() : array
+    // everything at once, in one array made at the right size
+    static NAN_METHOD(KeysArray);
+    static NAN_METHOD(ValuesArray);
+    static NAN_METHOD(EntriesArray);
+
     // map.clear() : undefined
     static NAN_METHOD(Clear);
 
     // map.forEach(function (key, value, map) {...}, context) : undefined
     static NAN_METHOD(ForEach);
+
+    // map.setMany([[key, value], ...]) : number of keys added
+    // map.setMany([key, ...], [value, ...]) : number of keys added
+    static NAN_METHOD(SetMany);
+
+    // map.getMany([key, ...]) : [value, ...]
+    static NAN_METHOD(GetMany);
+
+    // map.hasMany([key, ...]) : [boolean, ...]
+    static NAN_METHOD(HasMany);
+
+    // map.deleteMany([key, ...]) : number of keys deleted
+    static NAN_METHOD(DeleteMany);
+
+    // map.stats() : {size, capacity, loadFactor, maxProbe, averageProbe, holes, deleted,
+    //               iterators, rehashes, migrating, nativeBytes, counters}
+    // walks the index to measure it, so it's as slow as a rehash
+    static NAN_METHOD(Stats);
+
+    // map.memoryUsage() : number
+    // the native bytes the map holds right now, the same as stats().nativeBytes
+    static NAN_METHOD(MemoryUsage);
+
+    // map.countOperations(boolean) : undefined
+    // turns the counters stats() reports on, from zero, or off
+    static NAN_METHOD(CountOperations);
+
+    // map.reserve(count) : undefined
+    // sizes the table so count entries fit without growing it again
+    static NAN_METHOD(Reserve);
+
+    // map.shrinkToFit() : undefined
+    // hands back the memory the table doesn't need for its current entries
+    static NAN_METHOD(ShrinkToFit);
+
+    // map.saveSnapshot(path) : undefined
+    // writes the map to a file NodeMap.openSnapshot can map back in. Keys
+    // have to be numbers or strings and values serializable
+    static NAN_METHOD(SaveSnapshot);
+
+    // NodeMap.openSnapshot(path) : read-only map
+    static NAN_METHOD(OpenSnapshot);
 };
 
 #endif
@@ -0,0 +1,277 @@
+#include "primitive_map.h"
+#include "iterator.h"
+
+using namespace v8;
+
+template <typename K>
+void PrimitiveMap<K>::init(Local<Object> target) {
+    Nan::HandleScope scope;
+
+    Local<FunctionTemplate> constructor = Nan::New<FunctionTemplate>(Constructor);
+
+    // got to do the Symbol.iterator function by hand, no Nan support
+    Local<Symbol> symbol_iterator = Symbol::GetIterator(Isolate::GetCurrent());
+    Local<FunctionTemplate> entries_templt = Nan::New<FunctionTemplate>(
+        Entries
+        , Local<Value>()
+        , Nan::New<Signature>(constructor));
+    constructor->PrototypeTemplate()->Set(symbol_iterator, entries_templt);
+    entries_templt->SetClassName(Nan::New("Symbol(Symbol.iterator)").ToLocalChecked());
+
+    constructor->SetClassName(Nan::New(K::Name()).ToLocalChecked());
+    constructor->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(constructor, "set", Set);
+    Nan::SetPrototypeMethod(constructor, "get", Get);
+    Nan::SetPrototypeMethod(constructor, "has", Has);
+    Nan::SetPrototypeMethod(constructor, "entries", Entries);
+    Nan::SetPrototypeMethod(constructor, "keys", Keys);
+    Nan::SetPrototypeMethod(constructor, "values", Values);
+    Nan::SetPrototypeMethod(constructor, "delete", Delete);
+    Nan::SetPrototypeMethod(constructor, "clear", Clear);
+    Nan::SetPrototypeMethod(constructor, "forEach", ForEach);
+    Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("size").ToLocalChecked(), Size);
+
+    Nan::Set(target, Nan::New(K::Name()).ToLocalChecked(), Nan::GetFunction(constructor).ToLocalChecked());
+}
+
+template <typename K>
+PrimitiveMap<K>::PrimitiveMap() : _seed(process_hash_seed()) {
+}
+
+template <typename K>
+void PrimitiveMap<K>::Reseed() {
+    this->_seed = random_hash_seed(this->_set.Reseeds() != 0);
+    this->_set.Reseed(EntryRehasher(this->_seed));
+}
+
+template <typename K>
+PrimitiveMap<K>::~PrimitiveMap() {
+}
+
+template <typename K>
+uint32_t PrimitiveMap<K>::GetEnd() {
+    return this->_set.End();
+}
+
+template <typename K>
+bool PrimitiveMap<K>::IsValid(uint32_t pos, uint32_t version) {
+    return this->_set.At(pos).IsValid(version);
+}
+
+template <typename K>
+Local<Value> PrimitiveMap<K>::GetKey(uint32_t pos) {
+    return K::ToLocal(this->_set.At(pos).GetKey());
+}
+
+template <typename K>
+Local<Value> PrimitiveMap<K>::GetValue(uint32_t pos) {
+    return this->_set.At(pos).GetLocalValue();
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Constructor) {
+    Nan::HandleScope scope;
+    PrimitiveMap<K> *obj = new PrimitiveMap<K>();
+
+    obj->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+
+    if(info.Length() == 0) {
+        return;
+    }
+
+    Populate(info.This(), info[0]);
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Get) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+    typename K::Lookup key(info[0], obj->_seed);
+
+    // a key of the wrong type can't be in the map
+    uint32_t pos = key.IsValid() ? obj->_set.Find(key.GetHash(), primitive_key_equal_to<K>(key)) : TableType::npos;
+
+    if(pos == TableType::npos) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+
+    info.GetReturnValue().Set(obj->_set.At(pos).GetLocalValue());
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Has) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+    typename K::Lookup key(info[0], obj->_seed);
+
+    uint32_t pos = key.IsValid() ? obj->_set.Find(key.GetHash(), primitive_key_equal_to<K>(key)) : TableType::npos;
+
+    if(pos == TableType::npos) {
+        info.GetReturnValue().Set(Nan::False());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::True());
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Set) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 2) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+    typename K::Lookup key(info[0], obj->_seed);
+
+    if (!key.IsValid()) {
+        Nan::ThrowTypeError(K::WrongType());
+        return;
+    }
+
+    uint32_t pos = obj->_set.Find(key.GetHash(), primitive_key_equal_to<K>(key));
+
+    if(pos != TableType::npos) {
+        obj->_set.At(pos).ReplaceValue(obj->_version, info[1]);
+    } else {
+        pos = obj->_set.Insert(key.GetHash());
+        obj->_set.At(pos).Assign(obj->_version, key, info[1]);
+        if (obj->_set.Flooded()) {
+            obj->Reseed();
+        }
+    }
+
+    //Return this
+    info.GetReturnValue().Set(info.This());
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Entries) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+
+    Local<Object> iter = PairNodeIterator::New(PairNodeIterator::KEY_TYPE | PairNodeIterator::VALUE_TYPE, obj);
+
+    info.GetReturnValue().Set(iter);
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Keys) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+
+    Local<Object> iter = PairNodeIterator::New(PairNodeIterator::KEY_TYPE, obj);
+
+    info.GetReturnValue().Set(iter);
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Values) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+
+    Local<Object> iter = PairNodeIterator::New(PairNodeIterator::VALUE_TYPE, obj);
+
+    info.GetReturnValue().Set(iter);
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Delete) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+    typename K::Lookup key(info[0], obj->_seed);
+
+    uint32_t pos = key.IsValid() ? obj->_set.Find(key.GetHash(), primitive_key_equal_to<K>(key)) : TableType::npos;
+
+    if (pos == TableType::npos) {
+        info.GetReturnValue().Set(Nan::False());
+        return;
+    }
+
+    obj->_set.Erase(pos, key.GetHash());
+    info.GetReturnValue().Set(Nan::True());
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::Clear) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+
+    obj->_set.Clear();
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+template <typename K>
+NAN_GETTER(PrimitiveMap<K>::Size) {
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+    uint32_t size = obj->_set.Size();
+
+    info.GetReturnValue().Set(Nan::New<Integer>(size));
+    return;
+}
+
+template <typename K>
+NAN_METHOD(PrimitiveMap<K>::ForEach) {
+    Nan::HandleScope scope;
+
+    PrimitiveMap<K> *obj = Nan::ObjectWrap::Unwrap<PrimitiveMap<K> >(info.This());
+
+    if (info.Length() < 1 || !info[0]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+    Local<Function> cb = info[0].As<v8::Function>();
+
+    Local<Object> ctx;
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        ctx = Nan::To<Object>(info[1]).ToLocalChecked();
+    } else {
+        ctx = Nan::GetCurrentContext()->Global();
+    }
+
+    const unsigned argc = 3;
+    Local<Value> argv[argc];
+    argv[2] = info.This();
+
+    uint32_t version = obj->StartIterator();
+
+    // the callback can add entries, so the end is checked every time
+    for (uint32_t pos = 0; pos < obj->_set.End(); pos++) {
+        if (obj->IsValid(pos, version)) {
+            argv[0] = obj->GetValue(pos);
+            argv[1] = obj->GetKey(pos);
+            if (Nan::Call(cb, ctx, argc, argv).IsEmpty()) {
+                break;
+            }
+        }
+    }
+    obj->StopIterator();
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+template class PrimitiveMap<NumberKey>;
+template class PrimitiveMap<StringKey>;
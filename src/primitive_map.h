@@ -0,0 +1,294 @@
+#ifndef PRIMITIVE_MAP_H
+#define PRIMITIVE_MAP_H
+
+#include <node.h>
+#include <nan.h>
+#include "flat_table.h"
+#include "hash.h"
+#include "iterable_map.h"
+#include "small_string.h"
+#include "wtf8.h"
+
+// Key types for PrimitiveMap. Each one says how a key is stored natively
+// (Stored), how a key coming in from JS is looked at (Lookup) without
+// keeping a handle to it, and how both are hashed with the map's seed.
+
+struct NumberKey {
+    typedef double Stored;
+
+    class Lookup {
+    public:
+        Lookup(v8::Local<v8::Value> key, const HashSeed &seed) : _valid(key->IsNumber()), _number(0) {
+            if (_valid) {
+                _number = key.As<v8::Number>()->Value();
+            }
+            _hash = hash_double(_number, seed);
+        }
+
+        bool IsValid() const {
+            return _valid;
+        }
+
+        key_hash_t GetHash() const {
+            return _hash;
+        }
+
+        double GetNumber() const {
+            return _number;
+        }
+
+    private:
+        bool _valid;
+        double _number;
+        key_hash_t _hash;
+    };
+
+    static const char *Name() {
+        return "NumberMap";
+    }
+
+    static const char *WrongType() {
+        return "Key must be a number";
+    }
+
+    static void Store(Stored &stored, const Lookup &key) {
+        // -0 is stored as 0, like Map does
+        stored = key.GetNumber() == 0 ? 0 : key.GetNumber();
+    }
+
+    static void Clear(Stored &) {
+    }
+
+    static key_hash_t Hash(const Stored &stored, const HashSeed &seed) {
+        return hash_double(stored, seed);
+    }
+
+    // SameValueZero, so NaN finds NaN
+    static bool Equals(const Stored &stored, const Lookup &key) {
+        double number = key.GetNumber();
+        return stored == number || (stored != stored && number != number);
+    }
+
+    static v8::Local<v8::Value> ToLocal(const Stored &stored) {
+        return Nan::New<v8::Number>(stored);
+    }
+};
+
+// strings are kept as WTF-8, so lone surrogates come back as they went in
+struct StringKey {
+    typedef SmallString Stored;
+
+    class Lookup {
+    public:
+        Lookup(v8::Local<v8::Value> key, const HashSeed &seed)
+            : _valid(key->IsString())
+            , _wtf8(key) {
+            _hash = hash_bytes_seeded(*_wtf8, _wtf8.length(), seed);
+        }
+
+        bool IsValid() const {
+            return _valid;
+        }
+
+        key_hash_t GetHash() const {
+            return _hash;
+        }
+
+        const char *GetData() const {
+            return *_wtf8;
+        }
+
+        size_t GetLength() const {
+            return _wtf8.length();
+        }
+
+    private:
+        bool _valid;
+        Wtf8String _wtf8;
+        key_hash_t _hash;
+    };
+
+    static const char *Name() {
+        return "StringMap";
+    }
+
+    static const char *WrongType() {
+        return "Key must be a string";
+    }
+
+    static void Store(Stored &stored, const Lookup &key) {
+        stored.Assign(key.GetData(), key.GetLength());
+    }
+
+    static void Clear(Stored &stored) {
+        stored.Clear();
+    }
+
+    static key_hash_t Hash(const Stored &stored, const HashSeed &seed) {
+        return hash_bytes_seeded(stored.Data(), stored.Length(), seed);
+    }
+
+    static bool Equals(const Stored &stored, const Lookup &key) {
+        return stored.Equals(key.GetData(), key.GetLength());
+    }
+
+    static v8::Local<v8::Value> ToLocal(const Stored &stored) {
+        return wtf8_to_string(stored.Data(), stored.Length());
+    }
+};
+
+// an entry with a native key, only the value is a V8 handle. It is a hole
+// while the value handle is empty
+template <typename K>
+class PrimitiveEntry {
+public:
+    PrimitiveEntry() : _version(0), _hash(0) {}
+
+    ~PrimitiveEntry() {
+        this->Release();
+    }
+
+    void Assign(uint32_t version, const typename K::Lookup &key, v8::Local<v8::Value> value) {
+        _version = version;
+        _hash = key.GetHash();
+        K::Store(_key, key);
+        _persistent_value.Reset(value);
+    }
+
+    void Release() {
+        K::Clear(_key);
+        _persistent_value.Reset();
+    }
+
+    void ReplaceValue(uint32_t version, v8::Local<v8::Value> value) {
+        _version = version;
+        _persistent_value.Reset(value);
+    }
+
+    void SetHash(key_hash_t hash) {
+        _hash = hash;
+    }
+
+    bool IsHole() const {
+        return _persistent_value.IsEmpty();
+    }
+
+    bool IsValid(uint32_t version) const {
+        return !this->IsHole() && (_version <= version);
+    }
+
+    key_hash_t GetHash() const {
+        return _hash;
+    }
+
+    const typename K::Stored &GetKey() const {
+        return _key;
+    }
+
+    v8::Local<v8::Value> GetLocalValue() const {
+        return v8::Local<v8::Value>::New(v8::Isolate::GetCurrent(), this->_persistent_value);
+    }
+
+private:
+    typename K::Stored _key;
+    uint32_t _version;
+    key_hash_t _hash;
+    Nan::Persistent<v8::Value> _persistent_value;
+};
+
+template <typename K>
+struct primitive_key_hash
+{
+    size_t operator()(const PrimitiveEntry<K> &entry) const {
+        return entry.GetHash();
+    }
+};
+
+template <typename K>
+struct primitive_key_equal_to
+{
+    explicit primitive_key_equal_to(const typename K::Lookup &key) : _key(key) {}
+
+    bool operator()(const PrimitiveEntry<K> &entry, uint32_t) const {
+        return K::Equals(entry.GetKey(), _key);
+    }
+
+    const typename K::Lookup &_key;
+};
+
+// a map restricted to one primitive key type, with the ES6 Map api. Keys
+// never touch the V8 heap: they are hashed and compared natively, and
+// only the values are held by persistent handles
+template <typename K>
+class PrimitiveMap : public IterableMap {
+public:
+    typedef FlatTable<PrimitiveEntry<K>, primitive_key_hash<K> > TableType;
+
+    static void init(v8::Local<v8::Object> target);
+
+    uint32_t GetEnd();
+    bool IsValid(uint32_t pos, uint32_t version);
+    v8::Local<v8::Value> GetKey(uint32_t pos);
+    v8::Local<v8::Value> GetValue(uint32_t pos);
+
+private:
+    PrimitiveMap();
+    ~PrimitiveMap();
+
+    TableType _set;
+    // what the keys are hashed with, the process' seed until the table
+    // gets flooded
+    HashSeed _seed;
+
+    // hashes every key again with a new seed for TableType::Reseed
+    struct EntryRehasher {
+        explicit EntryRehasher(const HashSeed &seed) : _seed(seed) {}
+
+        void operator()(PrimitiveEntry<K> &entry, uint32_t) const {
+            entry.SetHash(K::Hash(entry.GetKey(), _seed));
+        }
+
+        const HashSeed &_seed;
+    };
+
+    // moves the table to a new seed once someone managed to flood it
+    void Reseed();
+
+    // new NumberMap() / new StringMap()
+    static NAN_METHOD(Constructor);
+
+    // map.set(key, value) : map
+    static NAN_METHOD(Set);
+
+    // map.get(key) : value
+    static NAN_METHOD(Get);
+
+    // map.has(key) : boolean
+    static NAN_METHOD(Has);
+
+    // map.entries() : iterator
+    static NAN_METHOD(Entries);
+
+    // map.keys() : iterator
+    static NAN_METHOD(Keys);
+
+    // map.values() : iterator
+    static NAN_METHOD(Values);
+
+    // map.size : number of elements
+    static NAN_GETTER(Size);
+
+    // map.delete(key) : boolean
+    static NAN_METHOD(Delete);
+
+    // map.clear() : undefined
+    static NAN_METHOD(Clear);
+
+    // map.forEach(function (value, key, map) {...}, context) : undefined
+    static NAN_METHOD(ForEach);
+};
+
+typedef PrimitiveMap<NumberKey> NumberMap;
+typedef PrimitiveMap<StringKey> StringMap;
+
+#endif
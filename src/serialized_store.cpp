@@ -0,0 +1,123 @@
+#include "serialized_store.h"
+#include <string.h>
+#include "checked_malloc.h"
+
+using namespace v8;
+
+SerializedStore::SerializedStore() : _bytes(0) {
+}
+
+SerializedStore::~SerializedStore() {
+    this->Clear();
+}
+
+bool SerializedStore::Serialize(Local<Value> value, SerializedValue *out) {
+#ifdef SERIALIZED_STORE_SUPPORTED
+    ValueSerializer serializer(Isolate::GetCurrent());
+
+    serializer.WriteHeader();
+    if (serializer.WriteValue(Nan::GetCurrentContext(), value).IsNothing()) {
+        // the serializer has thrown a DataCloneError
+        return false;
+    }
+
+    std::pair<uint8_t *, size_t> buffer = serializer.Release();
+    out->data = buffer.first;
+    out->length = buffer.second;
+    return true;
+#else
+    Nan::ThrowError("Serialized values need Node.js 8 or later");
+    return false;
+#endif
+}
+
+Local<Value> SerializedStore::Deserialize(const uint8_t *data, size_t length) {
+#ifdef SERIALIZED_STORE_SUPPORTED
+    ValueDeserializer deserializer(Isolate::GetCurrent(), data, length);
+    Local<Value> result;
+
+    // only ever fails on a buffer this store didn't write
+    if (deserializer.ReadHeader(Nan::GetCurrentContext()).IsNothing()
+        || !deserializer.ReadValue(Nan::GetCurrentContext()).ToLocal(&result)) {
+        return Nan::Undefined();
+    }
+    return result;
+#else
+    return Nan::Undefined();
+#endif
+}
+
+Local<Value> SerializedStore::Get(uint32_t pos) {
+    if (pos >= this->_values.size() || this->_values[pos].data == NULL) {
+        return Nan::Undefined();
+    }
+    return Deserialize(this->_values[pos].data, this->_values[pos].length);
+}
+
+void SerializedStore::Set(uint32_t pos, const SerializedValue &value) {
+    if (pos >= this->_values.size()) {
+        SerializedValue empty = {NULL, 0};
+        this->_values.resize(pos + 1, empty);
+    }
+    this->Release(pos);
+    this->_values[pos] = value;
+    this->_bytes += value.length;
+}
+
+void SerializedStore::Copy(uint32_t pos, const SerializedStore &other, uint32_t from) {
+    if (from >= other._values.size() || other._values[from].data == NULL) {
+        this->Release(pos);
+        return;
+    }
+
+    const SerializedValue &source = other._values[from];
+    SerializedValue copy;
+    copy.data = static_cast<uint8_t *>(checked_malloc(source.length));
+    memcpy(copy.data, source.data, source.length);
+    copy.length = source.length;
+    this->Set(pos, copy);
+}
+
+void SerializedStore::Release(uint32_t pos) {
+    if (pos >= this->_values.size()) {
+        return;
+    }
+
+    SerializedValue &value = this->_values[pos];
+    // buffers come from the serializer's default allocator, which is realloc
+    free(value.data);
+    this->_bytes -= value.length;
+    value.data = NULL;
+    value.length = 0;
+}
+
+void SerializedStore::Move(uint32_t to, uint32_t from) {
+    if (from >= this->_values.size()) {
+        this->Release(to);
+        return;
+    }
+
+    SerializedValue value = this->_values[from];
+    this->_values[from].data = NULL;
+    this->_values[from].length = 0;
+    this->_bytes -= value.length;
+    this->Set(to, value);
+}
+
+void SerializedStore::Truncate(uint32_t end) {
+    for (uint32_t pos = end; pos < this->_values.size(); pos++) {
+        this->Release(pos);
+    }
+    if (end < this->_values.size()) {
+        this->_values.resize(end);
+        this->_values.shrink_to_fit();
+    }
+}
+
+void SerializedStore::Clear() {
+    for (uint32_t pos = 0; pos < this->_values.size(); pos++) {
+        free(this->_values[pos].data);
+    }
+    std::vector<SerializedValue>().swap(this->_values);
+    this->_bytes = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef SERIALIZED_STORE_H
+#define SERIALIZED_STORE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#include <node.h>
+#include <nan.h>
+
+// V8 has had a public ValueSerializer since Node 8
+#if NODE_MODULE_VERSION >= NODE_8_0_MODULE_VERSION
+#define SERIALIZED_STORE_SUPPORTED 1
+#endif
+
+// a value as written by V8's ValueSerializer (the structured clone format
+// postMessage uses), in a malloc'd buffer
+struct SerializedValue {
+    uint8_t *data;
+    size_t length;
+};
+
+// values kept serialized in native memory instead of as V8 objects, one
+// buffer per position. They are invisible to the GC until they are read
+// back, and every read makes a fresh copy of the value
+class SerializedStore {
+public:
+    SerializedStore();
+    ~SerializedStore();
+
+    // writes value into out, returns false with an exception thrown if it
+    // can't be serialized (functions, symbols, ...)
+    static bool Serialize(v8::Local<v8::Value> value, SerializedValue *out);
+    // reads a serialized value back, undefined if it can't be
+    static v8::Local<v8::Value> Deserialize(const uint8_t *data, size_t length);
+
+    v8::Local<v8::Value> Get(uint32_t pos);
+
+    // takes value over, dropping what was at pos before
+    void Set(uint32_t pos, const SerializedValue &value);
+    // a copy of the buffer at other's from
+    void Copy(uint32_t pos, const SerializedStore &other, uint32_t from);
+
+    void Release(uint32_t pos);
+    void Move(uint32_t to, uint32_t from);
+    void Truncate(uint32_t end);
+    void Clear();
+
+    // bytes of serialized values held
+    size_t Bytes() const {
+        return this->_bytes;
+    }
+
+    // everything held besides the object itself, the buffers and what
+    // keeps track of them
+    size_t NativeBytes() const {
+        return this->_bytes + this->_values.capacity() * sizeof(SerializedValue);
+    }
+
+private:
+    std::vector<SerializedValue> _values;
+    size_t _bytes;
+};
+
+#endif
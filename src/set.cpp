@@ -0,0 +1,387 @@
+#include "set.h"
+#include "iterator.h"
+
+using namespace v8;
+
+thread_local Nan::Persistent<FunctionTemplate> NodeSet::_constructor;
+
+void NodeSet::init(Local<Object> target) {
+    Nan::HandleScope scope;
+
+    Local<FunctionTemplate> constructor = Nan::New<FunctionTemplate>(Constructor);
+
+    // got to do the Symbol.iterator function by hand, no Nan support
+    Local<Symbol> symbol_iterator = Symbol::GetIterator(Isolate::GetCurrent());
+    Local<FunctionTemplate> values_templt = Nan::New<FunctionTemplate>(
+        Values
+        , Local<Value>()
+        , Nan::New<Signature>(constructor));
+    constructor->PrototypeTemplate()->Set(symbol_iterator, values_templt);
+    values_templt->SetClassName(Nan::New("Symbol(Symbol.iterator)").ToLocalChecked());
+
+    _constructor.Reset(constructor);
+    constructor->SetClassName(Nan::New("NodeSet").ToLocalChecked());
+    constructor->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(constructor, "add", Add);
+    Nan::SetPrototypeMethod(constructor, "has", Has);
+    Nan::SetPrototypeMethod(constructor, "delete", Delete);
+    Nan::SetPrototypeMethod(constructor, "clear", Clear);
+    Nan::SetPrototypeMethod(constructor, "entries", Entries);
+    Nan::SetPrototypeMethod(constructor, "keys", Values);
+    Nan::SetPrototypeMethod(constructor, "values", Values);
+    Nan::SetPrototypeMethod(constructor, "forEach", ForEach);
+    Nan::SetPrototypeMethod(constructor, "union", Union);
+    Nan::SetPrototypeMethod(constructor, "intersection", Intersection);
+    Nan::SetPrototypeMethod(constructor, "difference", Difference);
+    Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("size").ToLocalChecked(), Size);
+
+    Nan::Set(target, Nan::New("NodeSet").ToLocalChecked(), Nan::GetFunction(constructor).ToLocalChecked());
+}
+
+NodeSet::NodeSet() : _seed(process_hash_seed()) {
+}
+
+NodeSet::~NodeSet() {
+}
+
+uint32_t NodeSet::GetEnd() {
+    return this->_set.End();
+}
+
+bool NodeSet::IsValid(uint32_t pos, uint32_t version) {
+    return this->_set.At(pos).IsValid(version);
+}
+
+Local<Value> NodeSet::GetKey(uint32_t pos) {
+    return this->_set.At(pos).GetLocalKey();
+}
+
+Local<Value> NodeSet::GetValue(uint32_t pos) {
+    return this->_set.At(pos).GetLocalKey();
+}
+
+KeyView NodeSet::KeyAt(uint32_t pos, const HashSeed &seed) const {
+    const VersionedPersistentKey &entry = this->_set.At(pos);
+
+    if (same_hash_seed(seed, this->_seed)) {
+        return KeyView(entry.GetLocalKey(), entry.GetHash());
+    }
+    return KeyView(entry.GetLocalKey(), seed);
+}
+
+uint32_t NodeSet::FindEntry(const KeyView &key) const {
+    return this->_set.Find(key.GetHash(), v8_value_equal_to(key));
+}
+
+bool NodeSet::AddEntry(const KeyView &key) {
+    SetType::InsertHint hint;
+    uint32_t pos = this->_set.FindOrPrepare(key.GetHash(), v8_value_equal_to(key), &hint);
+
+    if (pos != SetType::npos) {
+        return false;
+    }
+
+    pos = this->_set.Insert(key.GetHash(), hint);
+    this->_set.At(pos).Assign(this->_version, key);
+    if (this->_set.Flooded()) {
+        this->Reseed();
+    }
+    return true;
+}
+
+bool NodeSet::DeleteEntry(const KeyView &key) {
+    uint32_t pos = this->FindEntry(key);
+
+    if (pos == SetType::npos) {
+        return false;
+    }
+
+    // released in place, running iterators just skip the hole
+    this->_set.Erase(pos, key.GetHash());
+    return true;
+}
+
+void NodeSet::Reseed() {
+    Nan::HandleScope scope;
+
+    this->_seed = random_hash_seed(this->_set.Reseeds() != 0);
+    this->_set.Reseed(EntryRehasher(this->_seed));
+}
+
+NodeSet *NodeSet::NewInstance(Local<Object> *handle) {
+    Local<Function> constructor = Nan::GetFunction(Nan::New(_constructor)).ToLocalChecked();
+
+    if (!Nan::NewInstance(constructor).ToLocal(handle)) {
+        return NULL;
+    }
+    return Nan::ObjectWrap::Unwrap<NodeSet>(*handle);
+}
+
+NodeSet *NodeSet::Other(const Nan::FunctionCallbackInfo<v8::Value> &info) {
+    if (info.Length() < 1 || !Nan::New(_constructor)->HasInstance(info[0])) {
+        return NULL;
+    }
+    return Nan::ObjectWrap::Unwrap<NodeSet>(info[0].As<Object>());
+}
+
+NAN_METHOD(NodeSet::Constructor) {
+    Nan::HandleScope scope;
+    NodeSet *obj = new NodeSet();
+
+    obj->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+
+    if (info.Length() == 0 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        return;
+    }
+
+    // another NodeSet is copied table and all, without rehashing a thing
+    if (Nan::New(_constructor)->HasInstance(info[0])) {
+        NodeSet *other = Nan::ObjectWrap::Unwrap<NodeSet>(info[0].As<Object>());
+        obj->_seed = other->_seed;
+        obj->_set.CopyFrom(other->_set, EntryCopier(obj));
+        return;
+    }
+
+    Populate(info.This(), info[0], false);
+    return;
+}
+
+NAN_METHOD(NodeSet::Add) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+
+    obj->AddEntry(KeyView(info[0], obj->_seed));
+
+    info.GetReturnValue().Set(info.This());
+    return;
+}
+
+NAN_METHOD(NodeSet::Has) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+    uint32_t pos = obj->FindEntry(KeyView(info[0], obj->_seed));
+
+    info.GetReturnValue().Set(Nan::New<Boolean>(pos != SetType::npos));
+    return;
+}
+
+NAN_METHOD(NodeSet::Delete) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || info[0]->IsUndefined() || info[0]->IsNull()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+
+    info.GetReturnValue().Set(Nan::New<Boolean>(obj->DeleteEntry(KeyView(info[0], obj->_seed))));
+    return;
+}
+
+NAN_METHOD(NodeSet::Clear) {
+    Nan::HandleScope scope;
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+
+    obj->_set.Clear();
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(NodeSet::Entries) {
+    Nan::HandleScope scope;
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+
+    Local<Object> iter = PairNodeIterator::New(PairNodeIterator::KEY_TYPE | PairNodeIterator::VALUE_TYPE, obj);
+
+    info.GetReturnValue().Set(iter);
+    return;
+}
+
+NAN_METHOD(NodeSet::Values) {
+    Nan::HandleScope scope;
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+
+    Local<Object> iter = PairNodeIterator::New(PairNodeIterator::KEY_TYPE, obj);
+
+    info.GetReturnValue().Set(iter);
+    return;
+}
+
+NAN_GETTER(NodeSet::Size) {
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+    uint32_t size = obj->_set.Size();
+
+    info.GetReturnValue().Set(Nan::New<Integer>(size));
+    return;
+}
+
+NAN_METHOD(NodeSet::ForEach) {
+    Nan::HandleScope scope;
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+
+    if (info.Length() < 1 || !info[0]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+    Local<Function> cb = info[0].As<v8::Function>();
+
+    Local<Object> ctx;
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        ctx = Nan::To<Object>(info[1]).ToLocalChecked();
+    } else {
+        ctx = Nan::GetCurrentContext()->Global();
+    }
+
+    const unsigned argc = 3;
+    Local<Value> argv[argc];
+    argv[2] = info.This();
+
+    uint32_t version = obj->StartIterator();
+
+    // the callback can add entries, so the end is checked every time
+    for (uint32_t pos = 0; pos < obj->_set.End(); pos++) {
+        if (obj->IsValid(pos, version)) {
+            argv[0] = obj->GetKey(pos);
+            argv[1] = argv[0];
+            if (Nan::Call(cb, ctx, argc, argv).IsEmpty()) {
+                break;
+            }
+        }
+    }
+    obj->StopIterator();
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(NodeSet::Union) {
+    Nan::HandleScope scope;
+
+    NodeSet *other = Other(info);
+    if (other == NULL) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+    Local<Object> handle;
+    NodeSet *result = NewInstance(&handle);
+    if (result == NULL) {
+        return;
+    }
+
+    // starts as a copy of this, so only other's keys are hashed again,
+    // and only if the seeds differ
+    result->_seed = obj->_seed;
+    result->_set.CopyFrom(obj->_set, EntryCopier(result));
+
+    uint32_t end = other->_set.End();
+    for (uint32_t pos = 0; pos < end; pos++) {
+        if (!other->_set.At(pos).IsHole()) {
+            Nan::HandleScope scope;
+            result->AddEntry(other->KeyAt(pos, result->_seed));
+        }
+    }
+
+    info.GetReturnValue().Set(handle);
+    return;
+}
+
+NAN_METHOD(NodeSet::Intersection) {
+    Nan::HandleScope scope;
+
+    NodeSet *other = Other(info);
+    if (other == NULL) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+    Local<Object> handle;
+    NodeSet *result = NewInstance(&handle);
+    if (result == NULL) {
+        return;
+    }
+
+    // walks the smaller set, looking each key up in the bigger one
+    NodeSet *smaller = obj->_set.Size() <= other->_set.Size() ? obj : other;
+    NodeSet *bigger = smaller == obj ? other : obj;
+    result->_seed = smaller->_seed;
+
+    uint32_t end = smaller->_set.End();
+    for (uint32_t pos = 0; pos < end; pos++) {
+        if (!smaller->_set.At(pos).IsHole()) {
+            Nan::HandleScope scope;
+            if (bigger->FindEntry(smaller->KeyAt(pos, bigger->_seed)) != SetType::npos) {
+                result->AddEntry(smaller->KeyAt(pos, result->_seed));
+            }
+        }
+    }
+
+    info.GetReturnValue().Set(handle);
+    return;
+}
+
+NAN_METHOD(NodeSet::Difference) {
+    Nan::HandleScope scope;
+
+    NodeSet *other = Other(info);
+    if (other == NULL) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    NodeSet *obj = Nan::ObjectWrap::Unwrap<NodeSet>(info.This());
+    Local<Object> handle;
+    NodeSet *result = NewInstance(&handle);
+    if (result == NULL) {
+        return;
+    }
+    result->_seed = obj->_seed;
+
+    // whichever of the two is smaller is walked: this, adding the keys
+    // other doesn't have, or other, deleting its keys from a copy of this
+    if (obj->_set.Size() <= other->_set.Size()) {
+        uint32_t end = obj->_set.End();
+        for (uint32_t pos = 0; pos < end; pos++) {
+            if (!obj->_set.At(pos).IsHole()) {
+                Nan::HandleScope scope;
+                if (other->FindEntry(obj->KeyAt(pos, other->_seed)) == SetType::npos) {
+                    result->AddEntry(obj->KeyAt(pos, result->_seed));
+                }
+            }
+        }
+    } else {
+        result->_set.CopyFrom(obj->_set, EntryCopier(result));
+        uint32_t end = other->_set.End();
+        for (uint32_t pos = 0; pos < end; pos++) {
+            if (!other->_set.At(pos).IsHole()) {
+                Nan::HandleScope scope;
+                result->DeleteEntry(other->KeyAt(pos, result->_seed));
+            }
+        }
+    }
+
+    info.GetReturnValue().Set(handle);
+    return;
+}
@@ -0,0 +1,110 @@
+#ifndef SET_H
+#define SET_H
+
+#include <node.h>
+#include <nan.h>
+#include "flat_table.h"
+#include "iterable_map.h"
+#include "v8_value_hasher.h"
+
+typedef FlatTable<VersionedPersistentKey, v8_value_hash> SetType;
+
+// a set with the ES6 Set api on the same table as NodeMap, keys hashed
+// and compared the same way. Its entries only hold a key, so each one
+// costs a single global handle. Iterators are the map's, with the key as
+// the value too, like Set's
+class NodeSet : public IterableMap {
+public:
+    static void init(v8::Local<v8::Object> target);
+
+    uint32_t GetEnd();
+    bool IsValid(uint32_t pos, uint32_t version);
+    v8::Local<v8::Value> GetKey(uint32_t pos);
+    v8::Local<v8::Value> GetValue(uint32_t pos);
+
+private:
+    NodeSet();
+    ~NodeSet();
+
+    // one per isolate, like NodeMap's
+    static thread_local Nan::Persistent<v8::FunctionTemplate> _constructor;
+
+    SetType _set;
+    // what the keys are hashed with, the process' seed until the table
+    // gets flooded
+    HashSeed _seed;
+
+    // fills in a copied entry for SetType::CopyFrom
+    struct EntryCopier {
+        explicit EntryCopier(NodeSet *to) : _to(to) {}
+
+        void operator()(VersionedPersistentKey &entry, const VersionedPersistentKey &other, uint32_t) const {
+            Nan::HandleScope scope;
+            entry.Assign(_to->_version, KeyView(other.GetLocalKey(), other.GetHash()));
+        }
+
+        NodeSet *_to;
+    };
+
+    // hashes every key again with a new seed for SetType::Reseed
+    struct EntryRehasher {
+        explicit EntryRehasher(const HashSeed &seed) : _seed(seed) {}
+
+        void operator()(VersionedPersistentKey &entry, uint32_t) const {
+            entry.SetHash(v8_key_hash(entry.GetLocalKey(), _seed));
+        }
+
+        const HashSeed &_seed;
+    };
+
+    // the key at pos as a lookup in a set hashed with seed, keeping its
+    // hash when the seeds are the same
+    KeyView KeyAt(uint32_t pos, const HashSeed &seed) const;
+    uint32_t FindEntry(const KeyView &key) const;
+    // returns true if key wasn't in the set before
+    bool AddEntry(const KeyView &key);
+    // returns true if there was an entry to delete
+    bool DeleteEntry(const KeyView &key);
+    // moves the table to a new seed once someone managed to flood it
+    void Reseed();
+    // a new, empty NodeSet, or NULL with an exception thrown
+    static NodeSet *NewInstance(v8::Local<v8::Object> *handle);
+    // the NodeSet a set algebra method was given, or NULL
+    static NodeSet *Other(const Nan::FunctionCallbackInfo<v8::Value> &info);
+
+    // new NodeSet([iterable])
+    static NAN_METHOD(Constructor);
+
+    // set.add(value) : set
+    static NAN_METHOD(Add);
+
+    // set.has(value) : boolean
+    static NAN_METHOD(Has);
+
+    // set.delete(value) : boolean
+    static NAN_METHOD(Delete);
+
+    // set.clear() : undefined
+    static NAN_METHOD(Clear);
+
+    // set.entries() : iterator of [value, value]
+    static NAN_METHOD(Entries);
+
+    // set.keys() / set.values() : iterator
+    static NAN_METHOD(Values);
+
+    // set.size : number of elements
+    static NAN_GETTER(Size);
+
+    // set.forEach(function (value, value, set) {...}, context) : undefined
+    static NAN_METHOD(ForEach);
+
+    // set.union(other) / set.intersection(other) / set.difference(other) : set
+    // a new NodeSet made from two of them table to table, without calling
+    // into JS. Entries keep their hashes when both sets share a seed
+    static NAN_METHOD(Union);
+    static NAN_METHOD(Intersection);
+    static NAN_METHOD(Difference);
+};
+
+#endif
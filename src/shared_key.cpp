@@ -0,0 +1,42 @@
+#include "shared_key.h"
+#include "wtf8.h"
+
+using namespace v8;
+
+static const char kNumberTag = 'n';
+static const char kStringTag = 's';
+
+SharedKey::SharedKey(Local<Value> key) : _valid(false), _hash(0) {
+    if (key->IsNumber()) {
+        double number = key.As<Number>()->Value();
+        if (number == 0) {
+            number = 0;
+        } else if (number != number) {
+            uint64_t nan = 0x7ff8000000000000ULL;
+            memcpy(&number, &nan, sizeof(number));
+        }
+        _bytes.push_back(kNumberTag);
+        _bytes.append(reinterpret_cast<const char *>(&number), sizeof(number));
+        _valid = true;
+    } else if (key->IsString()) {
+        Wtf8String wtf8(key);
+        _bytes.push_back(kStringTag);
+        _bytes.append(*wtf8, wtf8.length());
+        _valid = true;
+    }
+    _hash = hash_fold(hash_bytes(_bytes.data(), _bytes.size()));
+}
+
+SharedKey::SharedKey(const char *data, size_t length) : _bytes(data, length) {
+    _valid = length > 0 && (data[0] == kNumberTag || data[0] == kStringTag);
+    _hash = hash_fold(hash_bytes(_bytes.data(), _bytes.size()));
+}
+
+Local<Value> SharedKey::ToLocal(const char *data, size_t length) {
+    if (length == 1 + sizeof(double) && data[0] == kNumberTag) {
+        double number;
+        memcpy(&number, data + 1, sizeof(number));
+        return Nan::New<Number>(number);
+    }
+    return wtf8_to_string(data + 1, length - 1);
+}
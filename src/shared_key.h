@@ -0,0 +1,48 @@
+#ifndef SHARED_KEY_H
+#define SHARED_KEY_H
+
+#include <string>
+#include <node.h>
+#include <nan.h>
+#include "hash.h"
+
+// a key as the tables that live outside of an isolate (SharedTable and
+// snapshots) keep it: a tag byte for its type followed by its bytes, a
+// double for a number (0 for -0, one NaN for every NaN) and WTF-8 for a
+// string. Made from a JS value on the calling thread, so the table itself
+// never touches an isolate. The hash only depends on those bytes, so it is
+// the same in every process, which snapshot files rely on. It isn't seeded
+// though, so the tables in memory hash the bytes again with a seed
+class SharedKey {
+public:
+    explicit SharedKey(v8::Local<v8::Value> key);
+    // a key from bytes kept by one of those tables, which can be made on
+    // any thread
+    SharedKey(const char *data, size_t length);
+
+    bool IsValid() const {
+        return _valid;
+    }
+
+    key_hash_t GetHash() const {
+        return _hash;
+    }
+
+    const char *Data() const {
+        return _bytes.data();
+    }
+
+    size_t Length() const {
+        return _bytes.size();
+    }
+
+    // the JS value for the stored bytes of a key
+    static v8::Local<v8::Value> ToLocal(const char *data, size_t length);
+
+private:
+    bool _valid;
+    std::string _bytes;
+    key_hash_t _hash;
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include "shared_map.h"
+#include <map>
+#include "snapshot.h"
+
+using namespace v8;
+
+// tables by name, and the lock that guards it and every table's _refs
+static uv_once_t registry_once = UV_ONCE_INIT;
+static uv_mutex_t registry_lock;
+static std::map<std::string, SharedTable *> *registry;
+
+static void InitRegistry() {
+    uv_mutex_init(&registry_lock);
+    registry = new std::map<std::string, SharedTable *>();
+}
+
+SharedTable *SharedTable::Acquire(const std::string &name) {
+    uv_once(&registry_once, InitRegistry);
+    uv_mutex_lock(&registry_lock);
+
+    SharedTable *table;
+    std::map<std::string, SharedTable *>::iterator found = registry->find(name);
+    if (found != registry->end()) {
+        table = found->second;
+    } else {
+        table = new SharedTable(name);
+        (*registry)[name] = table;
+    }
+    table->_refs++;
+
+    uv_mutex_unlock(&registry_lock);
+    return table;
+}
+
+void SharedTable::Release() {
+    uv_mutex_lock(&registry_lock);
+
+    bool last = --this->_refs == 0;
+    if (last) {
+        registry->erase(this->_name);
+    }
+
+    uv_mutex_unlock(&registry_lock);
+    if (last) {
+        delete this;
+    }
+}
+
+SharedTable::SharedTable(const std::string &name) : _name(name), _refs(0) {
+    for (uint32_t i = 0; i < kShards; i++) {
+        uv_rwlock_init(&this->_shards[i].lock);
+        this->_shards[i].seed = process_hash_seed();
+    }
+}
+
+SharedTable::~SharedTable() {
+    for (uint32_t i = 0; i < kShards; i++) {
+        uv_rwlock_destroy(&this->_shards[i].lock);
+    }
+}
+
+bool SharedTable::Get(const SharedKey &key, std::string *out) {
+    Shard &shard = this->ShardOf(key);
+
+    uv_rwlock_rdlock(&shard.lock);
+    uint32_t pos = shard.table.Find(shard.Hash(key), shared_key_equal_to(key));
+    if (pos != ShardTable::npos) {
+        const SmallString &value = shard.table.At(pos).GetValue();
+        out->assign(value.Data(), value.Length());
+    }
+    uv_rwlock_rdunlock(&shard.lock);
+
+    return pos != ShardTable::npos;
+}
+
+bool SharedTable::Has(const SharedKey &key) {
+    Shard &shard = this->ShardOf(key);
+
+    uv_rwlock_rdlock(&shard.lock);
+    uint32_t pos = shard.table.Find(shard.Hash(key), shared_key_equal_to(key));
+    uv_rwlock_rdunlock(&shard.lock);
+
+    return pos != ShardTable::npos;
+}
+
+bool SharedTable::Set(const SharedKey &key, const SerializedValue &value) {
+    Shard &shard = this->ShardOf(key);
+
+    uv_rwlock_wrlock(&shard.lock);
+    key_hash_t hash = shard.Hash(key);
+    uint32_t pos = shard.table.Find(hash, shared_key_equal_to(key));
+    bool added = pos == ShardTable::npos;
+    if (added) {
+        pos = shard.table.Insert(hash);
+        shard.table.At(pos).Assign(key, hash, value);
+        if (shard.table.Flooded()) {
+            shard.seed = random_hash_seed(shard.table.Reseeds() != 0);
+            shard.table.Reseed(EntryRehasher(shard.seed));
+        }
+    } else {
+        shard.table.At(pos).ReplaceValue(value);
+    }
+    uv_rwlock_wrunlock(&shard.lock);
+
+    return added;
+}
+
+bool SharedTable::Delete(const SharedKey &key) {
+    Shard &shard = this->ShardOf(key);
+
+    uv_rwlock_wrlock(&shard.lock);
+    key_hash_t hash = shard.Hash(key);
+    uint32_t pos = shard.table.Find(hash, shared_key_equal_to(key));
+    if (pos != ShardTable::npos) {
+        shard.table.Erase(pos, hash);
+    }
+    uv_rwlock_wrunlock(&shard.lock);
+
+    return pos != ShardTable::npos;
+}
+
+void SharedTable::Clear() {
+    for (uint32_t i = 0; i < kShards; i++) {
+        uv_rwlock_wrlock(&this->_shards[i].lock);
+        this->_shards[i].table.Clear();
+        uv_rwlock_wrunlock(&this->_shards[i].lock);
+    }
+}
+
+void SharedTable::Reserve(size_t count) {
+    for (uint32_t i = 0; i < kShards; i++) {
+        uv_rwlock_wrlock(&this->_shards[i].lock);
+        ShardTable &table = this->_shards[i].table;
+        table.Reserve(static_cast<uint32_t>(table.Size() + count / kShards + 1));
+        uv_rwlock_wrunlock(&this->_shards[i].lock);
+    }
+}
+
+size_t SharedTable::Size() {
+    size_t size = 0;
+    for (uint32_t i = 0; i < kShards; i++) {
+        uv_rwlock_rdlock(&this->_shards[i].lock);
+        size += this->_shards[i].table.Size();
+        uv_rwlock_rdunlock(&this->_shards[i].lock);
+    }
+    return size;
+}
+
+void SharedTable::Snapshot(uint32_t shard, std::vector<std::pair<std::string, std::string> > *out) {
+    ShardTable &table = this->_shards[shard].table;
+
+    uv_rwlock_rdlock(&this->_shards[shard].lock);
+    out->reserve(table.Size());
+    for (uint32_t pos = 0; pos < table.End(); pos++) {
+        const SharedEntry &entry = table.At(pos);
+        if (!entry.IsHole()) {
+            out->push_back(std::make_pair(
+                std::string(entry.GetKey().Data(), entry.GetKey().Length()),
+                std::string(entry.GetValue().Data(), entry.GetValue().Length())));
+        }
+    }
+    uv_rwlock_rdunlock(&this->_shards[shard].lock);
+}
+
+// loads a snapshot into a SharedTable. Everything but the callback runs on
+// the thread pool: the file is mapped, every record is checked and the
+// entries are set one at a time under their shard's lock, so readers of
+// the table keep going while it fills up
+class LoadWorker : public Nan::AsyncWorker {
+public:
+    LoadWorker(Nan::Callback *callback, SharedTable *table, const std::string &path)
+        : Nan::AsyncWorker(callback, "es6-native-map:SharedMap.loadAsync"), _table(table), _path(path) {
+    }
+
+    ~LoadWorker() {
+        this->_table->Release();
+    }
+
+    void Execute() {
+        std::string error;
+        Snapshot *snapshot = Snapshot::Open(this->_path, &error);
+
+        if (snapshot == NULL) {
+            this->SetErrorMessage(error.c_str());
+            return;
+        }
+
+        this->_table->Reserve(snapshot->Size());
+        for (uint64_t bucket = 0; bucket < snapshot->BucketCount(); bucket++) {
+            const SnapshotRecord *record = snapshot->AtBucket(bucket);
+            if (record == NULL) {
+                continue;
+            }
+            SharedKey key(Snapshot::KeyOf(record), record->key_length);
+            if (!key.IsValid()) {
+                this->SetErrorMessage((this->_path + " is not a snapshot").c_str());
+                break;
+            }
+            // the table copies the value out of the mapping
+            SerializedValue value = {const_cast<uint8_t *>(Snapshot::ValueOf(record)), record->value_length};
+            this->_table->Set(key, value);
+        }
+        delete snapshot;
+    }
+
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+        Local<Value> argv[2] = {Nan::Null(), SharedMap::New(this->_table->GetName())};
+
+        this->callback->Call(2, argv, this->async_resource);
+    }
+
+private:
+    // held from the call until the worker is done, so the table is there
+    // for the callback even if no SharedMap has it open
+    SharedTable *_table;
+    std::string _path;
+};
+
+// values are read back from a copy taken under the shard's lock
+static Local<Value> Deserialize(const std::string &bytes) {
+    return SerializedStore::Deserialize(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size());
+}
+
+thread_local Nan::Persistent<FunctionTemplate> SharedMap::_constructor;
+
+void SharedMap::init(Local<Object> target) {
+    Nan::HandleScope scope;
+
+    Local<FunctionTemplate> constructor = Nan::New<FunctionTemplate>(Constructor);
+
+    _constructor.Reset(constructor);
+    constructor->SetClassName(Nan::New("SharedMap").ToLocalChecked());
+    constructor->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(constructor, "set", Set);
+    Nan::SetPrototypeMethod(constructor, "get", Get);
+    Nan::SetPrototypeMethod(constructor, "has", Has);
+    Nan::SetPrototypeMethod(constructor, "delete", Delete);
+    Nan::SetPrototypeMethod(constructor, "clear", Clear);
+    Nan::SetPrototypeMethod(constructor, "forEach", ForEach);
+    Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("size").ToLocalChecked(), Size);
+    Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("name").ToLocalChecked(), Name);
+    Nan::SetMethod(constructor, "loadAsync", LoadAsync);
+
+    Nan::Set(target, Nan::New("SharedMap").ToLocalChecked(), Nan::GetFunction(constructor).ToLocalChecked());
+}
+
+Local<Value> SharedMap::New(const std::string &name) {
+    Nan::EscapableHandleScope scope;
+
+    Local<Value> argv[1] = {Nan::New<String>(name.data(), static_cast<int>(name.size())).ToLocalChecked()};
+    Local<Function> constructor = Nan::GetFunction(Nan::New(_constructor)).ToLocalChecked();
+
+    return scope.Escape(Nan::NewInstance(constructor, 1, argv).ToLocalChecked());
+}
+
+SharedMap::SharedMap(SharedTable *table) : _table(table) {
+}
+
+SharedMap::~SharedMap() {
+    this->_table->Release();
+}
+
+NAN_METHOD(SharedMap::Constructor) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsString()) {
+        Nan::ThrowTypeError("SharedMap needs a name");
+        return;
+    }
+
+    Nan::Utf8String name(info[0]);
+    SharedMap *obj = new SharedMap(SharedTable::Acquire(std::string(*name, name.length())));
+
+    obj->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+    return;
+}
+
+NAN_METHOD(SharedMap::LoadAsync) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 3 || !info[0]->IsString() || !info[1]->IsString() || !info[2]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    Nan::Utf8String name(info[0]);
+    Nan::Utf8String path(info[1]);
+    Nan::Callback *callback = new Nan::Callback(info[2].As<Function>());
+
+    Nan::AsyncQueueWorker(new LoadWorker(callback,
+        SharedTable::Acquire(std::string(*name, name.length())),
+        std::string(*path, path.length())));
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(SharedMap::Set) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 2) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+    SharedKey key(info[0]);
+
+    if (!key.IsValid()) {
+        Nan::ThrowTypeError("Key must be a number or a string");
+        return;
+    }
+
+    SerializedValue value;
+    if (!SerializedStore::Serialize(info[1], &value)) {
+        return;
+    }
+    obj->_table->Set(key, value);
+    free(value.data);
+
+    //Return this
+    info.GetReturnValue().Set(info.This());
+    return;
+}
+
+NAN_METHOD(SharedMap::Get) {
+    Nan::HandleScope scope;
+
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+    SharedKey key(info[0]);
+    std::string value;
+
+    if (!key.IsValid() || !obj->_table->Get(key, &value)) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+
+    info.GetReturnValue().Set(Deserialize(value));
+    return;
+}
+
+NAN_METHOD(SharedMap::Has) {
+    Nan::HandleScope scope;
+
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+    SharedKey key(info[0]);
+
+    if (!key.IsValid() || !obj->_table->Has(key)) {
+        info.GetReturnValue().Set(Nan::False());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::True());
+    return;
+}
+
+NAN_METHOD(SharedMap::Delete) {
+    Nan::HandleScope scope;
+
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+    SharedKey key(info[0]);
+
+    if (!key.IsValid() || !obj->_table->Delete(key)) {
+        info.GetReturnValue().Set(Nan::False());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::True());
+    return;
+}
+
+NAN_METHOD(SharedMap::Clear) {
+    Nan::HandleScope scope;
+
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+
+    obj->_table->Clear();
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(SharedMap::ForEach) {
+    Nan::HandleScope scope;
+
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+
+    if (info.Length() < 1 || !info[0]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+    Local<Function> cb = info[0].As<v8::Function>();
+
+    Local<Object> ctx;
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        ctx = Nan::To<Object>(info[1]).ToLocalChecked();
+    } else {
+        ctx = Nan::GetCurrentContext()->Global();
+    }
+
+    const unsigned argc = 3;
+    Local<Value> argv[argc];
+    argv[2] = info.This();
+
+    // the callback runs with no lock held, so it can write to the map
+    for (uint32_t shard = 0; shard < SharedTable::kShards; shard++) {
+        std::vector<std::pair<std::string, std::string> > entries;
+        obj->_table->Snapshot(shard, &entries);
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            Nan::HandleScope entry_scope;
+            argv[0] = Deserialize(entries[i].second);
+            argv[1] = SharedKey::ToLocal(entries[i].first.data(), entries[i].first.size());
+            if (Nan::Call(cb, ctx, argc, argv).IsEmpty()) {
+                return;
+            }
+        }
+    }
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_GETTER(SharedMap::Size) {
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+
+    info.GetReturnValue().Set(Nan::New<Number>(static_cast<double>(obj->_table->Size())));
+    return;
+}
+
+NAN_GETTER(SharedMap::Name) {
+    SharedMap *obj = Nan::ObjectWrap::Unwrap<SharedMap>(info.This());
+    const std::string &name = obj->_table->GetName();
+
+    info.GetReturnValue().Set(Nan::New<String>(name.data(), static_cast<int>(name.size())).ToLocalChecked());
+    return;
+}
@@ -0,0 +1,210 @@
+#ifndef SHARED_MAP_H
+#define SHARED_MAP_H
+
+#include <string>
+#include <node.h>
+#include <nan.h>
+#include <uv.h>
+#include "flat_table.h"
+#include "hash.h"
+#include "serialized_store.h"
+#include "shared_key.h"
+#include "small_string.h"
+
+// an entry of a shard, everything in it is native memory
+class SharedEntry {
+public:
+    SharedEntry() : _used(false), _hash(0) {}
+
+    // hash is the key's hash with the shard's seed
+    void Assign(const SharedKey &key, key_hash_t hash, const SerializedValue &value) {
+        _used = true;
+        _hash = hash;
+        _key.Assign(key.Data(), key.Length());
+        this->ReplaceValue(value);
+    }
+
+    void ReplaceValue(const SerializedValue &value) {
+        _value.Assign(reinterpret_cast<const char *>(value.data), value.length);
+    }
+
+    void Release() {
+        _used = false;
+        _key.Clear();
+        _value.Clear();
+    }
+
+    bool IsHole() const {
+        return !_used;
+    }
+
+    key_hash_t GetHash() const {
+        return _hash;
+    }
+
+    void SetHash(key_hash_t hash) {
+        _hash = hash;
+    }
+
+    const SmallString &GetKey() const {
+        return _key;
+    }
+
+    const SmallString &GetValue() const {
+        return _value;
+    }
+
+private:
+    bool _used;
+    key_hash_t _hash;
+    SmallString _key;
+    SmallString _value;
+};
+
+struct shared_entry_hash
+{
+    size_t operator()(const SharedEntry &entry) const {
+        return entry.GetHash();
+    }
+};
+
+struct shared_key_equal_to
+{
+    explicit shared_key_equal_to(const SharedKey &key) : _key(key) {}
+
+    bool operator()(const SharedEntry &entry, uint32_t) const {
+        return entry.GetKey().Equals(_key.Data(), _key.Length());
+    }
+
+    const SharedKey &_key;
+};
+
+// the table behind a SharedMap. It lives outside of every isolate and is
+// found by name, so each worker that opens the same name gets the same
+// table. Keys are spread over kShards shards by hash, each one a FlatTable
+// behind its own read/write lock: any number of threads can read a shard
+// at once, and a write only holds up the one shard it lands in. Within a
+// shard keys are hashed again with the shard's seed, so they can't be
+// picked to collide
+class SharedTable {
+public:
+    static const uint32_t kShards = 16;
+
+    // the table called name, made if there isn't one yet. Every Acquire
+    // is matched by a Release, and the table goes away with the last one
+    static SharedTable *Acquire(const std::string &name);
+    void Release();
+
+    const std::string &GetName() const {
+        return _name;
+    }
+
+    // copies the serialized value of key into out, returns false if the
+    // key isn't there
+    bool Get(const SharedKey &key, std::string *out);
+    bool Has(const SharedKey &key);
+    // returns true if key wasn't there before
+    bool Set(const SharedKey &key, const SerializedValue &value);
+    bool Delete(const SharedKey &key);
+    void Clear();
+    // makes room for count more entries, spread evenly over the shards
+    void Reserve(size_t count);
+    size_t Size();
+
+    // copies out every key and serialized value of one shard, so they can
+    // be handed to JS without holding its lock
+    void Snapshot(uint32_t shard, std::vector<std::pair<std::string, std::string> > *out);
+
+private:
+    typedef FlatTable<SharedEntry, shared_entry_hash> ShardTable;
+
+    struct Shard {
+        uv_rwlock_t lock;
+        // changes when the shard gets flooded, under the write lock
+        HashSeed seed;
+        ShardTable table;
+
+        key_hash_t Hash(const SharedKey &key) const {
+            return hash_bytes_seeded(key.Data(), key.Length(), this->seed);
+        }
+    };
+
+    // hashes every key of a shard again for ShardTable::Reseed
+    struct EntryRehasher {
+        explicit EntryRehasher(const HashSeed &seed) : _seed(seed) {}
+
+        void operator()(SharedEntry &entry, uint32_t) const {
+            entry.SetHash(hash_bytes_seeded(entry.GetKey().Data(), entry.GetKey().Length(), _seed));
+        }
+
+        const HashSeed &_seed;
+    };
+
+    explicit SharedTable(const std::string &name);
+    ~SharedTable();
+
+    Shard &ShardOf(const SharedKey &key) {
+        // the key's own hash isn't seeded, but it only picks the shard
+        return _shards[key.GetHash() >> 28];
+    }
+
+    std::string _name;
+    // SharedMap objects using this table, over every thread. Guarded by
+    // the registry lock
+    uint32_t _refs;
+    Shard _shards[kShards];
+};
+
+// the JS side of a SharedTable: new SharedMap(name) in any thread opens
+// the table of that name. Keys are numbers or strings, and values are
+// anything that can be serialized, they are copied in and out
+class SharedMap : public Nan::ObjectWrap {
+public:
+    static void init(v8::Local<v8::Object> target);
+    // new SharedMap(name), from native code
+    static v8::Local<v8::Value> New(const std::string &name);
+
+private:
+    explicit SharedMap(SharedTable *table);
+    ~SharedMap();
+
+    // one per isolate, like NodeMap's
+    static thread_local Nan::Persistent<v8::FunctionTemplate> _constructor;
+
+    SharedTable *_table;
+
+    // new SharedMap(name)
+    static NAN_METHOD(Constructor);
+
+    // SharedMap.loadAsync(name, path, function (err, map) {...}) : undefined
+    // reads a snapshot file into the table called name on the thread pool,
+    // the event loop only runs the callback
+    static NAN_METHOD(LoadAsync);
+
+    // map.set(key, value) : map
+    static NAN_METHOD(Set);
+
+    // map.get(key) : value
+    static NAN_METHOD(Get);
+
+    // map.has(key) : boolean
+    static NAN_METHOD(Has);
+
+    // map.delete(key) : boolean
+    static NAN_METHOD(Delete);
+
+    // map.clear() : undefined
+    static NAN_METHOD(Clear);
+
+    // map.forEach(function (value, key, map) {...}, context) : undefined
+    // sees each shard as it was when the callback got to it
+    static NAN_METHOD(ForEach);
+
+    // map.size : number of elements
+    static NAN_GETTER(Size);
+
+    // map.name : the name the table was opened with
+    static NAN_GETTER(Name);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SMALL_STRING_H
+#define SMALL_STRING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checked_malloc.h"
+
+// a string of bytes owned outside of the V8 heap. Strings of up to
+// kInline bytes are kept in the object itself, longer ones in a heap
+// block whose pointer takes the place of the inline bytes, so the whole
+// thing is 16 bytes either way
+class SmallString {
+public:
+    static const uint32_t kInline = 12;
+
+    SmallString() : _length(0) {}
+
+    ~SmallString() {
+        this->Clear();
+    }
+
+    void Assign(const char *data, size_t length) {
+        this->Clear();
+        if (length <= kInline) {
+            memcpy(this->_bytes, data, length);
+        } else {
+            char *heap = static_cast<char *>(checked_malloc(length));
+            memcpy(heap, data, length);
+            memcpy(this->_bytes, &heap, sizeof(heap));
+        }
+        this->_length = static_cast<uint32_t>(length);
+    }
+
+    void Clear() {
+        if (this->_length > kInline) {
+            free(this->HeapData());
+        }
+        this->_length = 0;
+    }
+
+    const char *Data() const {
+        if (this->_length > kInline) {
+            return this->HeapData();
+        }
+        return this->_bytes;
+    }
+
+    size_t Length() const {
+        return this->_length;
+    }
+
+    bool Equals(const char *data, size_t length) const {
+        return this->_length == length && memcmp(this->Data(), data, length) == 0;
+    }
+
+    // bytes held outside of the object itself
+    size_t HeapSize() const {
+        return this->_length > kInline ? this->_length : 0;
+    }
+
+private:
+    SmallString(const SmallString &);
+    SmallString &operator=(const SmallString &);
+
+    char *HeapData() const {
+        char *heap;
+        memcpy(&heap, this->_bytes, sizeof(heap));
+        return heap;
+    }
+
+    uint32_t _length;
+    char _bytes[kInline];
+};
+
+#endif
@@ -0,0 +1,407 @@
+#include "snapshot.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace v8;
+
+static const uint8_t kPadding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+static uint64_t PaddedLength(uint64_t length) {
+    return (length + 7) & ~static_cast<uint64_t>(7);
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &path)
+    : _path(path), _tmp_path(path + ".tmp"), _file(NULL), _offset(0) {
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    // only still open if Finish never got to the end
+    if (this->_file != NULL) {
+        fclose(this->_file);
+        remove(this->_tmp_path.c_str());
+    }
+}
+
+bool SnapshotWriter::Fail(const char *what) {
+    this->_error = std::string(what) + " " + this->_tmp_path + ": " + strerror(errno);
+    return false;
+}
+
+bool SnapshotWriter::Write(const void *data, size_t length) {
+    if (length > 0 && fwrite(data, 1, length, this->_file) != length) {
+        return this->Fail("Could not write");
+    }
+    this->_offset += length;
+    return true;
+}
+
+bool SnapshotWriter::Open() {
+    this->_file = fopen(this->_tmp_path.c_str(), "wb");
+    if (this->_file == NULL) {
+        return this->Fail("Could not open");
+    }
+
+    // the header is written again with the real numbers by Finish
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    return this->Write(&header, sizeof(header));
+}
+
+bool SnapshotWriter::Add(const SharedKey &key, const SerializedValue &value) {
+    SnapshotRecord record;
+    uint64_t length = sizeof(record) + key.Length() + value.length;
+
+    if (key.Length() > UINT32_MAX || value.length > UINT32_MAX) {
+        errno = EFBIG;
+        return this->Fail("Could not write");
+    }
+    record.hash = key.GetHash();
+    record.key_length = static_cast<uint32_t>(key.Length());
+    record.value_length = static_cast<uint32_t>(value.length);
+    record.reserved = 0;
+
+    this->_records.push_back(std::make_pair(record.hash, this->_offset));
+    return this->Write(&record, sizeof(record))
+        && this->Write(key.Data(), key.Length())
+        && this->Write(value.data, value.length)
+        && this->Write(kPadding, PaddedLength(length) - length);
+}
+
+bool SnapshotWriter::Finish() {
+    SnapshotHeader header;
+
+    // at most half full, so probes stay short
+    uint64_t bucket_count = 16;
+    while (bucket_count < this->_records.size() * 2) {
+        bucket_count <<= 1;
+    }
+
+    std::vector<uint64_t> index(bucket_count, 0);
+    for (size_t i = 0; i < this->_records.size(); i++) {
+        uint64_t bucket = snapshot_bucket(this->_records[i].first, bucket_count);
+        while (index[bucket] != 0) {
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        index[bucket] = this->_records[i].second;
+    }
+
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.byte_order = kSnapshotByteOrder;
+    header.count = this->_records.size();
+    header.bucket_count = bucket_count;
+    header.index_offset = this->_offset;
+    header.file_size = this->_offset + bucket_count * sizeof(uint64_t);
+
+    if (!this->Write(&index[0], bucket_count * sizeof(uint64_t))) {
+        return false;
+    }
+    if (fseek(this->_file, 0, SEEK_SET) != 0 || fwrite(&header, 1, sizeof(header), this->_file) != sizeof(header)) {
+        return this->Fail("Could not write");
+    }
+
+    FILE *file = this->_file;
+    this->_file = NULL;
+    if (fclose(file) != 0) {
+        remove(this->_tmp_path.c_str());
+        return this->Fail("Could not write");
+    }
+#ifdef _WIN32
+    // rename doesn't replace an existing file on Windows
+    remove(this->_path.c_str());
+#endif
+    if (rename(this->_tmp_path.c_str(), this->_path.c_str()) != 0) {
+        int error = errno;
+        remove(this->_tmp_path.c_str());
+        errno = error;
+        return this->Fail("Could not rename");
+    }
+    return true;
+}
+
+Snapshot::Snapshot(const uint8_t *data, size_t length, bool mapped)
+    : _data(data), _length(length), _mapped(mapped) {
+}
+
+Snapshot::~Snapshot() {
+#ifndef _WIN32
+    if (this->_mapped) {
+        munmap(const_cast<uint8_t *>(this->_data), this->_length);
+        return;
+    }
+#endif
+    free(const_cast<uint8_t *>(this->_data));
+}
+
+// checks everything in the header that a lookup relies on, the records are
+// checked as they are read
+static bool IsValidHeader(const uint8_t *data, size_t length) {
+    const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader *>(data);
+
+    if (length < sizeof(SnapshotHeader) || memcmp(header->magic, kSnapshotMagic, sizeof(header->magic)) != 0) {
+        return false;
+    }
+    if (header->version != kSnapshotVersion || header->byte_order != kSnapshotByteOrder) {
+        return false;
+    }
+    if (header->file_size != length || header->index_offset < sizeof(SnapshotHeader) || header->index_offset % 8 != 0) {
+        return false;
+    }
+    if (header->bucket_count == 0 || (header->bucket_count & (header->bucket_count - 1)) != 0) {
+        return false;
+    }
+    return header->index_offset <= length
+        && header->bucket_count == (length - header->index_offset) / sizeof(uint64_t)
+        && header->count < header->bucket_count;
+}
+
+Snapshot *Snapshot::Open(const std::string &path, std::string *error) {
+    const uint8_t *data = NULL;
+    size_t length = 0;
+    bool mapped = false;
+
+#ifdef _WIN32
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        *error = "Could not open " + path + ": " + strerror(errno);
+        return NULL;
+    }
+    // no mmap here, the file is read in once instead
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+            uint8_t *buffer = static_cast<uint8_t *>(malloc(size));
+            if (buffer != NULL && fread(buffer, 1, size, file) == static_cast<size_t>(size)) {
+                data = buffer;
+                length = size;
+            } else {
+                free(buffer);
+            }
+        }
+    }
+    fclose(file);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        *error = "Could not open " + path + ": " + strerror(errno);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            data = static_cast<const uint8_t *>(mapping);
+            length = st.st_size;
+            mapped = true;
+        }
+    }
+    // the mapping keeps the file around by itself
+    close(fd);
+#endif
+
+    Snapshot *snapshot = new Snapshot(data, length, mapped);
+    if (data == NULL || !IsValidHeader(data, length)) {
+        *error = path + " is not a snapshot";
+        delete snapshot;
+        return NULL;
+    }
+    return snapshot;
+}
+
+const SnapshotRecord *Snapshot::RecordAt(uint64_t offset) const {
+    uint64_t end = this->Header()->index_offset;
+
+    if (offset < sizeof(SnapshotHeader) || offset % 8 != 0 || offset > end
+            || end - offset < sizeof(SnapshotRecord)) {
+        return NULL;
+    }
+    const SnapshotRecord *record = reinterpret_cast<const SnapshotRecord *>(this->_data + offset);
+    if (record->key_length == 0
+            || static_cast<uint64_t>(record->key_length) + record->value_length > end - offset - sizeof(SnapshotRecord)) {
+        return NULL;
+    }
+    return record;
+}
+
+const SnapshotRecord *Snapshot::AtBucket(uint64_t bucket) const {
+    const uint64_t *index = reinterpret_cast<const uint64_t *>(this->_data + this->Header()->index_offset);
+
+    if (index[bucket] == 0) {
+        return NULL;
+    }
+    return this->RecordAt(index[bucket]);
+}
+
+const SnapshotRecord *Snapshot::Find(const SharedKey &key) const {
+    const uint64_t *index = reinterpret_cast<const uint64_t *>(this->_data + this->Header()->index_offset);
+    uint64_t mask = this->BucketCount() - 1;
+    uint64_t bucket = snapshot_bucket(key.GetHash(), this->BucketCount());
+
+    // there is always an empty bucket, but a broken file might not have one
+    for (uint64_t probes = 0; probes <= mask && index[bucket] != 0; probes++) {
+        const SnapshotRecord *record = this->RecordAt(index[bucket]);
+        if (record == NULL) {
+            return NULL;
+        }
+        if (record->hash == key.GetHash() && record->key_length == key.Length()
+                && memcmp(KeyOf(record), key.Data(), key.Length()) == 0) {
+            return record;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+    return NULL;
+}
+
+thread_local Nan::Persistent<FunctionTemplate> SnapshotMap::_constructor;
+
+void SnapshotMap::init(Local<Object> target) {
+    Nan::HandleScope scope;
+
+    Local<FunctionTemplate> constructor = Nan::New<FunctionTemplate>(Constructor);
+
+    _constructor.Reset(constructor);
+    constructor->SetClassName(Nan::New("SnapshotMap").ToLocalChecked());
+    constructor->InstanceTemplate()->SetInternalFieldCount(1);
+
+    Nan::SetPrototypeMethod(constructor, "get", Get);
+    Nan::SetPrototypeMethod(constructor, "has", Has);
+    Nan::SetPrototypeMethod(constructor, "forEach", ForEach);
+    Nan::SetPrototypeMethod(constructor, "close", Close);
+    Nan::SetAccessor(constructor->InstanceTemplate(), Nan::New("size").ToLocalChecked(), Size);
+
+    // exported for instanceof, only openSnapshot can make one
+    Nan::Set(target, Nan::New("SnapshotMap").ToLocalChecked(), Nan::GetFunction(constructor).ToLocalChecked());
+}
+
+Local<Value> SnapshotMap::New(Snapshot *snapshot) {
+    Nan::EscapableHandleScope scope;
+
+    Local<Value> argv[1] = {Nan::New<External>(snapshot)};
+    Local<Function> constructor = Nan::GetFunction(Nan::New(_constructor)).ToLocalChecked();
+
+    return scope.Escape(Nan::NewInstance(constructor, 1, argv).ToLocalChecked());
+}
+
+SnapshotMap::SnapshotMap(Snapshot *snapshot) : _snapshot(snapshot) {
+}
+
+SnapshotMap::~SnapshotMap() {
+    delete this->_snapshot;
+}
+
+NAN_METHOD(SnapshotMap::Constructor) {
+    Nan::HandleScope scope;
+
+    if (info.Length() < 1 || !info[0]->IsExternal()) {
+        Nan::ThrowTypeError("Use NodeMap.openSnapshot(path)");
+        return;
+    }
+
+    SnapshotMap *obj = new SnapshotMap(static_cast<Snapshot *>(info[0].As<External>()->Value()));
+
+    obj->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+    return;
+}
+
+// the record for info[0], NULL if it isn't there or the map was closed
+#define FIND_RECORD(obj, info) \
+    ((obj)->_snapshot == NULL ? NULL : (obj)->_snapshot->Find(SharedKey((info)[0])))
+
+NAN_METHOD(SnapshotMap::Get) {
+    Nan::HandleScope scope;
+
+    SnapshotMap *obj = Nan::ObjectWrap::Unwrap<SnapshotMap>(info.This());
+    const SnapshotRecord *record = FIND_RECORD(obj, info);
+
+    if (record == NULL) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+
+    info.GetReturnValue().Set(SerializedStore::Deserialize(Snapshot::ValueOf(record), record->value_length));
+    return;
+}
+
+NAN_METHOD(SnapshotMap::Has) {
+    Nan::HandleScope scope;
+
+    SnapshotMap *obj = Nan::ObjectWrap::Unwrap<SnapshotMap>(info.This());
+
+    if (FIND_RECORD(obj, info) == NULL) {
+        info.GetReturnValue().Set(Nan::False());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::True());
+    return;
+}
+
+#undef FIND_RECORD
+
+NAN_METHOD(SnapshotMap::ForEach) {
+    Nan::HandleScope scope;
+
+    SnapshotMap *obj = Nan::ObjectWrap::Unwrap<SnapshotMap>(info.This());
+
+    if (info.Length() < 1 || !info[0]->IsFunction()) {
+        Nan::ThrowTypeError("Wrong arguments");
+        return;
+    }
+    Local<Function> cb = info[0].As<v8::Function>();
+
+    Local<Object> ctx;
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        ctx = Nan::To<Object>(info[1]).ToLocalChecked();
+    } else {
+        ctx = Nan::GetCurrentContext()->Global();
+    }
+
+    const unsigned argc = 3;
+    Local<Value> argv[argc];
+    argv[2] = info.This();
+
+    // goes by the index, the callback closing the map ends it
+    for (uint64_t bucket = 0; obj->_snapshot != NULL && bucket < obj->_snapshot->BucketCount(); bucket++) {
+        const SnapshotRecord *record = obj->_snapshot->AtBucket(bucket);
+        if (record == NULL) {
+            continue;
+        }
+        Nan::HandleScope entry_scope;
+        argv[0] = SerializedStore::Deserialize(Snapshot::ValueOf(record), record->value_length);
+        argv[1] = SharedKey::ToLocal(Snapshot::KeyOf(record), record->key_length);
+        if (Nan::Call(cb, ctx, argc, argv).IsEmpty()) {
+            return;
+        }
+    }
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_METHOD(SnapshotMap::Close) {
+    Nan::HandleScope scope;
+
+    SnapshotMap *obj = Nan::ObjectWrap::Unwrap<SnapshotMap>(info.This());
+
+    delete obj->_snapshot;
+    obj->_snapshot = NULL;
+
+    info.GetReturnValue().Set(Nan::Undefined());
+    return;
+}
+
+NAN_GETTER(SnapshotMap::Size) {
+    SnapshotMap *obj = Nan::ObjectWrap::Unwrap<SnapshotMap>(info.This());
+    uint64_t size = obj->_snapshot != NULL ? obj->_snapshot->Size() : 0;
+
+    info.GetReturnValue().Set(Nan::New<Number>(static_cast<double>(size)));
+    return;
+}
@@ -0,0 +1,166 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <node.h>
+#include <nan.h>
+#include "serialized_store.h"
+#include "shared_key.h"
+
+// A snapshot file is a read-only map laid out so it can be used straight
+// from a memory mapping:
+//
+//   header   SnapshotHeader
+//   records  one per entry, each a SnapshotRecord followed by the key
+//            (SharedKey bytes) and the value (ValueSerializer bytes),
+//            padded to 8 bytes
+//   index    bucket_count file offsets of records (0 for an empty bucket),
+//            open addressing with linear probing, at most half full
+//
+// Numbers are in the byte order of the machine that wrote it, which the
+// header records so a file from the other kind is refused.
+
+static const char kSnapshotMagic[8] = {'N', 'M', 'A', 'P', 'S', 'N', 'A', 'P'};
+static const uint32_t kSnapshotVersion = 1;
+static const uint32_t kSnapshotByteOrder = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;
+    uint64_t bucket_count;
+    uint64_t index_offset;
+    uint64_t file_size;
+};
+
+struct SnapshotRecord {
+    key_hash_t hash;
+    uint32_t key_length;
+    uint32_t value_length;
+    uint32_t reserved;
+};
+
+// writes a snapshot to path + ".tmp", renamed over path by Finish so that
+// a reader never sees half a file
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string &path);
+    ~SnapshotWriter();
+
+    // each returns false with Error() set when the file can't be written
+    bool Open();
+    bool Add(const SharedKey &key, const SerializedValue &value);
+    bool Finish();
+
+    const std::string &Error() const {
+        return _error;
+    }
+
+private:
+    bool Write(const void *data, size_t length);
+    bool Fail(const char *what);
+
+    std::string _path;
+    std::string _tmp_path;
+    std::string _error;
+    FILE *_file;
+    uint64_t _offset;
+    // the hash and offset of every record, for the index
+    std::vector<std::pair<key_hash_t, uint64_t> > _records;
+};
+
+// a snapshot file mapped into memory. Lookups read the mapping directly,
+// so opening one costs the same no matter how big it is, and processes
+// that open the same file share its pages
+class Snapshot {
+public:
+    // returns NULL with error set if path isn't a snapshot this can read
+    static Snapshot *Open(const std::string &path, std::string *error);
+    ~Snapshot();
+
+    uint64_t Size() const {
+        return this->Header()->count;
+    }
+
+    // the record for key, or NULL
+    const SnapshotRecord *Find(const SharedKey &key) const;
+
+    // the record in bucket, or NULL if it's empty
+    const SnapshotRecord *AtBucket(uint64_t bucket) const;
+
+    uint64_t BucketCount() const {
+        return this->Header()->bucket_count;
+    }
+
+    static const char *KeyOf(const SnapshotRecord *record) {
+        return reinterpret_cast<const char *>(record + 1);
+    }
+
+    static const uint8_t *ValueOf(const SnapshotRecord *record) {
+        return reinterpret_cast<const uint8_t *>(record + 1) + record->key_length;
+    }
+
+private:
+    Snapshot(const uint8_t *data, size_t length, bool mapped);
+
+    const SnapshotHeader *Header() const {
+        return reinterpret_cast<const SnapshotHeader *>(this->_data);
+    }
+
+    // checks that a record offset from the index lies inside the file
+    const SnapshotRecord *RecordAt(uint64_t offset) const;
+
+    const uint8_t *_data;
+    size_t _length;
+    // whether _data is a mapping, or a heap copy where there's no mmap
+    bool _mapped;
+};
+
+// the bucket a hash starts probing from, bucket_count is a power of 2.
+// Part of the file format, so it can't change without a new version
+inline uint64_t snapshot_bucket(key_hash_t hash, uint64_t bucket_count) {
+    uint64_t mixed = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+    return (mixed ^ (mixed >> 32)) & (bucket_count - 1);
+}
+
+// what NodeMap.openSnapshot(path) returns: a read-only map over a
+// Snapshot, with values deserialized on the way out
+class SnapshotMap : public Nan::ObjectWrap {
+public:
+    static void init(v8::Local<v8::Object> target);
+    // takes snapshot over
+    static v8::Local<v8::Value> New(Snapshot *snapshot);
+
+private:
+    explicit SnapshotMap(Snapshot *snapshot);
+    ~SnapshotMap();
+
+    static thread_local Nan::Persistent<v8::FunctionTemplate> _constructor;
+
+    Snapshot *_snapshot;
+
+    // only made by NodeMap.openSnapshot
+    static NAN_METHOD(Constructor);
+
+    // map.get(key) : value
+    static NAN_METHOD(Get);
+
+    // map.has(key) : boolean
+    static NAN_METHOD(Has);
+
+    // map.forEach(function (value, key, map) {...}, context) : undefined
+    static NAN_METHOD(ForEach);
+
+    // map.close() : undefined
+    // unmaps the file, the map is empty afterwards
+    static NAN_METHOD(Close);
+
+    // map.size : number of elements
+    static NAN_GETTER(Size);
+};
+
+#endif
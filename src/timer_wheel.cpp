@@ -0,0 +1,185 @@
+#include "timer_wheel.h"
+
+// the number of ticks a slot of level spans
+static inline uint64_t SlotSpan(uint32_t level, uint32_t bits) {
+    return static_cast<uint64_t>(1) << (level * bits);
+}
+
+TimerWheel::TimerWheel(uint64_t now) : _current(now) {
+    this->Clear();
+}
+
+void TimerWheel::Schedule(uint32_t pos, uint64_t expires) {
+    if (pos >= this->_nodes.size()) {
+        Node none = {0, kNone, kNone, kNone};
+        this->_nodes.resize(pos + 1, none);
+    }
+    this->Unlink(pos);
+    this->_nodes[pos].expires = expires;
+    this->Link(pos);
+}
+
+void TimerWheel::Cancel(uint32_t pos) {
+    if (pos < this->_nodes.size()) {
+        this->Unlink(pos);
+    }
+}
+
+uint64_t TimerWheel::Expires(uint32_t pos) const {
+    if (pos >= this->_nodes.size() || this->_nodes[pos].slot == kNone) {
+        return 0;
+    }
+    return this->_nodes[pos].expires;
+}
+
+void TimerWheel::Link(uint32_t pos) {
+    Node &node = this->_nodes[pos];
+    // anything already due goes in the slot expired next, and anything past
+    // the top level waits in its last slot to be filed again
+    uint64_t expires = node.expires < this->_current ? this->_current : node.expires;
+    uint64_t delta = expires - this->_current;
+    uint32_t level = 0;
+
+    while (level < kLevels - 1 && delta >= SlotSpan(level + 1, kSlotBits)) {
+        level++;
+    }
+    if (delta >= SlotSpan(kLevels, kSlotBits)) {
+        expires = this->_current + SlotSpan(kLevels, kSlotBits) - 1;
+    }
+
+    uint32_t slot = level * kSlots + static_cast<uint32_t>((expires >> (level * kSlotBits)) & (kSlots - 1));
+    node.slot = slot;
+    node.prev = kNone;
+    node.next = this->_heads[slot];
+    if (node.next != kNone) {
+        this->_nodes[node.next].prev = pos;
+    }
+    this->_heads[slot] = pos;
+    this->_level_count[level]++;
+    this->_count++;
+}
+
+void TimerWheel::Unlink(uint32_t pos) {
+    Node &node = this->_nodes[pos];
+
+    if (node.slot == kNone) {
+        return;
+    }
+    if (node.prev != kNone) {
+        this->_nodes[node.prev].next = node.next;
+    } else {
+        this->_heads[node.slot] = node.next;
+    }
+    if (node.next != kNone) {
+        this->_nodes[node.next].prev = node.prev;
+    }
+    this->_level_count[node.slot / kSlots]--;
+    this->_count--;
+    node.slot = kNone;
+    node.prev = kNone;
+    node.next = kNone;
+}
+
+void TimerWheel::Cascade(uint32_t level) {
+    uint32_t slot = level * kSlots + static_cast<uint32_t>((this->_current >> (level * kSlotBits)) & (kSlots - 1));
+    uint32_t pos = this->_heads[slot];
+
+    while (pos != kNone) {
+        uint32_t next = this->_nodes[pos].next;
+        this->Unlink(pos);
+        this->Link(pos);
+        pos = next;
+    }
+}
+
+void TimerWheel::Advance(uint64_t now, std::vector<uint32_t> *expired) {
+    while (this->_current <= now && this->_count != 0) {
+        // on a boundary the levels above are spread out top down, so what
+        // comes down from one level is spread again by the one below
+        uint32_t top = 0;
+        while (top < kLevels - 1 && (this->_current & (SlotSpan(top + 1, kSlotBits) - 1)) == 0) {
+            top++;
+        }
+        for (uint32_t level = top; level > 0; level--) {
+            this->Cascade(level);
+        }
+
+        uint32_t slot = static_cast<uint32_t>(this->_current & (kSlots - 1));
+        while (this->_heads[slot] != kNone) {
+            uint32_t pos = this->_heads[slot];
+            this->Unlink(pos);
+            expired->push_back(pos);
+        }
+        this->_current++;
+
+        // nothing happens until the next boundary of the lowest level that
+        // isn't empty
+        uint32_t empty = 0;
+        while (empty < kLevels && this->_level_count[empty] == 0) {
+            empty++;
+        }
+        if (empty > 0 && empty < kLevels) {
+            uint64_t mask = SlotSpan(empty, kSlotBits) - 1;
+            uint64_t boundary = (this->_current + mask) & ~mask;
+            this->_current = boundary < now + 1 ? boundary : now + 1;
+        }
+    }
+    if (this->_current <= now) {
+        // empty, so nothing is filed against the old time
+        this->_current = now + 1;
+    }
+}
+
+uint64_t TimerWheel::NextDue() const {
+    uint64_t due = UINT64_MAX;
+
+    if (this->_level_count[0] != 0) {
+        // level 0 only holds the next kSlots ticks
+        for (uint64_t tick = this->_current; tick < this->_current + kSlots; tick++) {
+            if (this->_heads[tick & (kSlots - 1)] != kNone) {
+                due = tick;
+                break;
+            }
+        }
+    }
+    // or the next boundary where the lowest level above comes down
+    for (uint32_t level = 1; level < kLevels; level++) {
+        if (this->_level_count[level] != 0) {
+            uint64_t mask = SlotSpan(level, kSlotBits) - 1;
+            uint64_t boundary = (this->_current + mask) & ~mask;
+            return boundary < due ? boundary : due;
+        }
+    }
+    return due;
+}
+
+void TimerWheel::Move(uint32_t to, uint32_t from) {
+    if (from >= this->_nodes.size() || this->_nodes[from].slot == kNone) {
+        this->Cancel(to);
+        return;
+    }
+    uint64_t expires = this->_nodes[from].expires;
+    this->Unlink(from);
+    this->Schedule(to, expires);
+}
+
+void TimerWheel::Truncate(uint32_t end) {
+    for (uint32_t pos = end; pos < this->_nodes.size(); pos++) {
+        this->Unlink(pos);
+    }
+    if (end < this->_nodes.size()) {
+        this->_nodes.resize(end);
+        this->_nodes.shrink_to_fit();
+    }
+}
+
+void TimerWheel::Clear() {
+    std::vector<Node>().swap(this->_nodes);
+    for (uint32_t slot = 0; slot < kLevels * kSlots; slot++) {
+        this->_heads[slot] = kNone;
+    }
+    for (uint32_t level = 0; level < kLevels; level++) {
+        this->_level_count[level] = 0;
+    }
+    this->_count = 0;
+}
@@ -0,0 +1,83 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// expiry times for the positions of a table, in a hierarchical timing
+// wheel. Level 0 has a slot per tick for the next kSlots ticks, and each
+// level above has slots kSlots times as wide. Positions are linked into
+// their slot's list through their node, so scheduling and cancelling are
+// O(1). As time moves on, the slot of each tick on level 0 expires, and
+// a slot of a level above is spread over the levels below once time gets
+// to it. Empty levels are skipped over whole, so Advance costs about the
+// number of positions it expires, not the time that went by or how many
+// positions are scheduled.
+//
+// Ticks are whatever unit the caller uses, NodeMap uses the milliseconds
+// of uv_now
+class TimerWheel {
+public:
+    explicit TimerWheel(uint64_t now);
+
+    // (re)schedules pos to expire at tick expires. A tick the wheel has
+    // already gone past counts as the next one
+    void Schedule(uint32_t pos, uint64_t expires);
+    void Cancel(uint32_t pos);
+    // the tick pos expires at, 0 if it isn't scheduled
+    uint64_t Expires(uint32_t pos) const;
+
+    // moves the wheel up to now, appending every position that expired on
+    // the way to expired. They are no longer scheduled afterwards
+    void Advance(uint64_t now, std::vector<uint32_t> *expired);
+
+    // the first tick Advance has anything to do at, expiring or moving
+    // positions down a level. Only meaningful while !Empty()
+    uint64_t NextDue() const;
+
+    bool Empty() const {
+        return this->_count == 0;
+    }
+
+    // memory held besides the object itself
+    size_t Bytes() const {
+        return this->_nodes.capacity() * sizeof(Node);
+    }
+
+    // like the other stores, for when the table moves its entries
+    void Move(uint32_t to, uint32_t from);
+    void Truncate(uint32_t end);
+    void Clear();
+
+private:
+    static const uint32_t kSlotBits = 6;
+    static const uint32_t kSlots = 1 << kSlotBits;
+    static const uint32_t kLevels = 5;
+    static const uint32_t kNone = 0xffffffff;
+
+    struct Node {
+        uint64_t expires;
+        uint32_t prev;
+        uint32_t next;
+        // level * kSlots + slot, or kNone if pos isn't scheduled
+        uint32_t slot;
+    };
+
+    // files a scheduled node into the slot its expiry falls in
+    void Link(uint32_t pos);
+    void Unlink(uint32_t pos);
+    // spreads a slot of a level above 0 over the levels below
+    void Cascade(uint32_t level);
+
+    std::vector<Node> _nodes;
+    // first position of each slot's list
+    uint32_t _heads[kLevels * kSlots];
+    // how many positions each level holds
+    uint32_t _level_count[kLevels];
+    uint32_t _count;
+    // the next tick to expire
+    uint64_t _current;
+};
+
+#endif
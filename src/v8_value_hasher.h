@@ -3,60 +3,269 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
 #include <node.h>
-#include <unordered_set>
 #include <nan.h>
+#include "hash.h"
 
-class VersionedPersistentPair {
-public:
-    VersionedPersistentPair(uint32_t version, v8::Local<v8::Value> key) : _version(version), _is_deleted(false) {
-        _persistent_key.Reset(key);
+// strings are hashed by their contents with the map's seed, read out a
+// chunk at a time on the stack. V8's own string hash can't be used: it's
+// at most 30 bits with one seed for the whole process, so strings that
+// collide in it would collide whatever seed the map moves on to. A string
+// of only Latin-1 characters is hashed a byte per character however V8
+// holds it, so equal strings always hash the same
+inline key_hash_t v8_string_hash(v8::Local<v8::String> str, const HashSeed &seed) {
+    const int chunk = 256;
+    SeededHasher hasher(seed);
+    int length = str->Length();
+
+    if (str->IsOneByte() || str->ContainsOnlyOneByte()) {
+        uint8_t buffer[chunk];
+        for (int start = 0; start < length; start += chunk) {
+#if NODE_MODULE_VERSION >= NODE_12_0_MODULE_VERSION
+            int written = str->WriteOneByte(v8::Isolate::GetCurrent(), buffer, start, chunk, v8::String::NO_NULL_TERMINATION);
+#else
+            int written = str->WriteOneByte(buffer, start, chunk, v8::String::NO_NULL_TERMINATION);
+#endif
+            hasher.Update(buffer, written);
+        }
+    } else {
+        uint16_t buffer[chunk];
+        for (int start = 0; start < length; start += chunk) {
+#if NODE_MODULE_VERSION >= NODE_12_0_MODULE_VERSION
+            int written = str->Write(v8::Isolate::GetCurrent(), buffer, start, chunk, v8::String::NO_NULL_TERMINATION);
+#else
+            int written = str->Write(buffer, start, chunk, v8::String::NO_NULL_TERMINATION);
+#endif
+            hasher.Update(buffer, written * sizeof(uint16_t));
+        }
     }
+    return hasher.Final();
+}
 
-    VersionedPersistentPair(uint32_t version, v8::Local<v8::Value> key, v8::Local<v8::Value> value) : _version(version), _is_deleted(false) {
-        _persistent_key.Reset(key);
-        _persistent_value.Reset(value);
+// the top bit of a key's hash says whether it's a composite key, so a
+// composite key never matches a plain one, not even an array of the same
+// values
+static const key_hash_t kCompositeHashBit = 0x80000000;
+
+// hashes a key the same way for a stored entry and for a lookup, without
+// allocating: strings by their contents, numbers by their bits, and
+// objects by identity, all mixed with the map's seed
+inline key_hash_t v8_key_hash(v8::Local<v8::Value> key, const HashSeed &seed) {
+    key_hash_t hash;
+    if (key->IsString()) {
+        hash = v8_string_hash(key.As<v8::String>(), seed);
+    } else if (key->IsNumber()) {
+        hash = hash_double(key.As<v8::Number>()->Value(), seed);
+    } else if (key->IsBoolean()) {
+        hash = hash_word_seeded(key->IsTrue() ? 1 : 2, seed);
+    } else {
+        hash = hash_word_seeded(static_cast<uint32_t>(Nan::To<v8::Object>(key).ToLocalChecked()->GetIdentityHash()), seed);
     }
+    return hash & ~kCompositeHashBit;
+}
 
-    VersionedPersistentPair(const VersionedPersistentPair &copy) {
-        Nan::HandleScope scope;
-        _is_deleted = copy._is_deleted;
-        _version = copy._version;
-        _persistent_key.Reset(copy.GetLocalKey());
-        _persistent_value.Reset(copy.GetLocalValue());
+// a composite key hashes the hashes of its parts together, in order
+inline key_hash_t v8_composite_hash(const v8::Local<v8::Value> *parts, uint32_t count, const HashSeed &seed) {
+    uint64_t hash = count;
+    for (uint32_t i = 0; i < count; i++) {
+        hash = hash_word_seeded((hash << 32) | v8_key_hash(parts[i], seed), seed);
     }
+    return static_cast<key_hash_t>(hash) | kCompositeHashBit;
+}
 
-    ~VersionedPersistentPair() {
-        this->Delete();
+// the hash of a key as an entry keeps it, where a composite key is the
+// array of its parts
+inline key_hash_t v8_stored_key_hash(v8::Local<v8::Value> key, bool composite, const HashSeed &seed) {
+    if (!composite) {
+        return v8_key_hash(key, seed);
+    }
+    v8::Local<v8::Array> tuple = key.As<v8::Array>();
+    std::vector<v8::Local<v8::Value> > parts(tuple->Length());
+    for (uint32_t i = 0; i < parts.size(); i++) {
+        parts[i] = Nan::Get(tuple, i).ToLocalChecked();
+    }
+    return v8_composite_hash(parts.data(), static_cast<uint32_t>(parts.size()), seed);
+}
+
+// keys are the same if they are SameValueZero, as for a Map: === except
+// that NaN is NaN
+inline bool v8_same_key(v8::Local<v8::Value> a, v8::Local<v8::Value> b) {
+    if (a->StrictEquals(b)) {
+        return true;
     }
+    if (!a->IsNumber() || !b->IsNumber()) {
+        return false;
+    }
+    double x = a.As<v8::Number>()->Value();
+    double y = b.As<v8::Number>()->Value();
+    return x != x && y != y;
+}
+
+// a key as it is passed in from JS, together with its hash. Lookups probe
+// the table with one of these, so a get/has/delete never creates global
+// handles or hashes the key twice
+class KeyView {
+public:
+    KeyView(v8::Local<v8::Value> key, const HashSeed &seed)
+        : _key(key), _parts(NULL), _count(0), _hash(v8_key_hash(key, seed)) {}
+    // a key as an entry keeps it, with its hash. A composite one is the
+    // frozen array of its parts, which another map can share
+    KeyView(v8::Local<v8::Value> key, key_hash_t hash)
+        : _key(key), _parts(NULL), _count(0), _hash(hash) {}
+    // a composite key of count values, compared one by one. The key itself,
+    // a frozen array of them, is only made if it gets stored
+    KeyView(const v8::Local<v8::Value> *parts, uint32_t count, const HashSeed &seed)
+        : _parts(parts), _count(count), _hash(v8_composite_hash(parts, count, seed)) {}
 
-    void Delete() const {
-        if (_is_deleted) {
-            return;
+    v8::Local<v8::Value> GetLocalKey() const {
+        if (_key.IsEmpty()) {
+            _key = this->MakeTuple();
         }
+        return _key;
+    }
 
-        _is_deleted = true;
-        _persistent_key.Reset();
-        _persistent_key.Empty();
+    key_hash_t GetHash() const {
+        return _hash;
+    }
 
-        if (!_persistent_value.IsEmpty()) {
-            _persistent_value.Reset();
-            _persistent_value.Empty();
+    // whether stored, the key of an entry with the same hash, is this key
+    bool Matches(v8::Local<v8::Value> stored) const {
+        bool composite = (_hash & kCompositeHashBit) != 0;
+        if (!composite) {
+            return v8_same_key(_key, stored);
         }
+
+        uint32_t count = _parts != NULL ? _count : _key.As<v8::Array>()->Length();
+        if (!stored->IsArray() || stored.As<v8::Array>()->Length() != count) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            v8::Local<v8::Value> part = _parts != NULL ? _parts[i] : Nan::Get(_key.As<v8::Object>(), i).ToLocalChecked();
+            if (!v8_same_key(part, Nan::Get(stored.As<v8::Object>(), i).ToLocalChecked())) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    void ReplaceValue(uint32_t version, v8::Local<v8::Value> value) const {
+private:
+    v8::Local<v8::Value> MakeTuple() const {
+        v8::Local<v8::Array> tuple = Nan::New<v8::Array>(_count);
+        for (uint32_t i = 0; i < _count; i++) {
+            Nan::Set(tuple, i, _parts[i]);
+        }
+#if NODE_MODULE_VERSION >= NODE_8_0_MODULE_VERSION
+        tuple->SetIntegrityLevel(Nan::GetCurrentContext(), v8::IntegrityLevel::kFrozen).FromMaybe(false);
+#endif
+        return tuple;
+    }
+
+    mutable v8::Local<v8::Value> _key;
+    const v8::Local<v8::Value> *_parts;
+    uint32_t _count;
+    key_hash_t _hash;
+};
+
+// an entry of the table. A default constructed one is a hole: a position
+// in the table that isn't in use, either never filled or released by a
+// delete. Holes are marked by their version rather than by empty handles,
+// since a map with an ArrayStore keeps no handles in its entries at all
+class VersionedPersistentPair {
+public:
+    static const uint32_t kHoleVersion = 0xffffffff;
+    static const uint32_t kNoLink = 0xffffffff;
+
+    VersionedPersistentPair() : _version(kHoleVersion), _older(kNoLink), _newer(kNoLink), _hash(0) {}
+
+    ~VersionedPersistentPair() {
+        this->Release();
+    }
+
+    void Assign(uint32_t version, const KeyView &key, v8::Local<v8::Value> value) {
         _version = version;
+        _hash = key.GetHash();
+        _persistent_key.Reset(key.GetLocalKey());
         _persistent_value.Reset(value);
-        _is_deleted = false;
     }
 
-    bool IsDeleted() const {
-        return _is_deleted;
+    // fills an entry whose key and value are kept somewhere else
+    void AssignStored(uint32_t version, key_hash_t hash) {
+        _version = version;
+        _hash = hash;
+    }
+
+    void MoveFrom(VersionedPersistentPair &other) {
+        Nan::HandleScope scope;
+        _version = other._version;
+        _older = other._older;
+        _newer = other._newer;
+        _hash = other._hash;
+        _persistent_key.Reset(other.GetLocalKey());
+        _persistent_value.Reset(other.GetLocalValue());
+        other.Release();
+    }
+
+    void Release() {
+        _version = kHoleVersion;
+        _older = kNoLink;
+        _newer = kNoLink;
+        _persistent_key.Reset();
+        _persistent_value.Reset();
+    }
+
+    void ReplaceValue(uint32_t version, v8::Local<v8::Value> value) {
+        _version = version;
+        _persistent_value.Reset(value);
+    }
+
+    void SetVersion(uint32_t version) {
+        _version = version;
+    }
+
+    void SetHash(key_hash_t hash) {
+        _hash = hash;
+    }
+
+    bool IsHole() const {
+        return _version == kHoleVersion;
+    }
+
+    // false for an entry whose value is kept somewhere else
+    bool HasValue() const {
+        return !_persistent_value.IsEmpty();
     }
 
     bool IsValid(uint32_t version) const {
-        return !_is_deleted && (_version <= version);
+        return !this->IsHole() && (_version <= version);
+    }
+
+    key_hash_t GetHash() const {
+        return _hash;
+    }
+
+    uint32_t GetOlder() const {
+        return _older;
+    }
+
+    uint32_t GetNewer() const {
+        return _newer;
+    }
+
+    void SetOlder(uint32_t pos) {
+        _older = pos;
+    }
+
+    void SetNewer(uint32_t pos) {
+        _newer = pos;
+    }
+
+    bool IsReferenced() const {
+        return _newer != kNoLink;
+    }
+
+    void SetReferenced(bool referenced) {
+        _newer = referenced ? 0 : kNoLink;
     }
 
     v8::Local<v8::Value> GetLocalKey() const {
@@ -68,45 +277,87 @@ public:
     }
 
 private:
-    mutable uint32_t _version;
-    mutable bool _is_deleted;
-    mutable Nan::Persistent<v8::Value> _persistent_key;
-    mutable Nan::Persistent<v8::Value> _persistent_value;
+    uint32_t _version;
+    // recency in a bounded map, kept here so a hit only writes to entries:
+    // the positions of the entries used just before and after this one in
+    // an LRU map, or in a CLOCK map whether it was used since the hand
+    // last went by (_newer set)
+    uint32_t _older;
+    uint32_t _newer;
+    // the key's hash, so rebuilding the index never has to look at the key
+    key_hash_t _hash;
+    Nan::Persistent<v8::Value> _persistent_key;
+    Nan::Persistent<v8::Value> _persistent_value;
 };
 
+// an entry of a NodeSet: a key and nothing else, no value handle and no
+// recency links
+class VersionedPersistentKey {
+public:
+    VersionedPersistentKey() : _version(VersionedPersistentPair::kHoleVersion), _hash(0) {}
+
+    ~VersionedPersistentKey() {
+        this->Release();
+    }
+
+    void Assign(uint32_t version, const KeyView &key) {
+        _version = version;
+        _hash = key.GetHash();
+        _persistent_key.Reset(key.GetLocalKey());
+    }
 
+    void Release() {
+        _version = VersionedPersistentPair::kHoleVersion;
+        _persistent_key.Reset();
+    }
+
+    void SetHash(key_hash_t hash) {
+        _hash = hash;
+    }
+
+    bool IsHole() const {
+        return _version == VersionedPersistentPair::kHoleVersion;
+    }
+
+    bool IsValid(uint32_t version) const {
+        return !this->IsHole() && (_version <= version);
+    }
+
+    key_hash_t GetHash() const {
+        return _hash;
+    }
+
+    v8::Local<v8::Value> GetLocalKey() const {
+        return v8::Local<v8::Value>::New(v8::Isolate::GetCurrent(), this->_persistent_key);
+    }
+
+private:
+    uint32_t _version;
+    key_hash_t _hash;
+    Nan::Persistent<v8::Value> _persistent_key;
+};
+
+
+// the hash of a stored entry, for when the index is rebuilt
 struct v8_value_hash
 {
-    size_t operator()(VersionedPersistentPair k) const {
-        Nan::HandleScope scope;
-        v8::Local<v8::Value> key = k.GetLocalKey();
-
-        std::string s;
-        if (key->IsString() || key->IsBoolean() || key->IsNumber()) {
-            return std::hash<std::string>()(*Nan::Utf8String(key));
-        }
-        return std::hash<int>()(Nan::To<v8::Object>(key).ToLocalChecked()->GetIdentityHash());
+    template <typename Entry>
+    size_t operator()(const Entry &k) const {
+        return k.GetHash();
     }
 };
 
+// matches stored entries against the key being looked up
 struct v8_value_equal_to
 {
-    bool operator()(VersionedPersistentPair pa, VersionedPersistentPair pb) const {
-        Nan::HandleScope scope;
+    explicit v8_value_equal_to(const KeyView &key) : _key(key) {}
 
-        if (pa.IsDeleted() || pb.IsDeleted()) {
-            return false;
-        }
-
-        v8::Local<v8::Value> a = pa.GetLocalKey();
-        v8::Local<v8::Value> b = pb.GetLocalKey();
-
-        if (a->StrictEquals(b)) {          /* same as JS === */
-            return true;
-        }
-
-        return Nan::To<v8::Object>(a).ToLocalChecked()->GetIdentityHash() == Nan::To<v8::Object>(b).ToLocalChecked()->GetIdentityHash();
+    template <typename Entry>
+    bool operator()(const Entry &entry, uint32_t) const {
+        return entry.GetHash() == _key.GetHash() && _key.Matches(entry.GetLocalKey());
     }
+
+    const KeyView &_key;
 };
 
 #endif
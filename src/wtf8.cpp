@@ -0,0 +1,143 @@
+#include "wtf8.h"
+#include <stdint.h>
+#include <vector>
+#include "checked_malloc.h"
+
+using namespace v8;
+
+static bool IsLeadSurrogate(uint16_t unit) {
+    return unit >= 0xd800 && unit <= 0xdbff;
+}
+
+static bool IsTrailSurrogate(uint16_t unit) {
+    return unit >= 0xdc00 && unit <= 0xdfff;
+}
+
+// encodes count UTF-16 units into out, which has room for 3 bytes each,
+// and returns where it stopped. A surrogate is only paired up with the
+// unit right after it
+static char *EncodeUnits(const uint16_t *units, int count, char *out) {
+    for (int i = 0; i < count; i++) {
+        uint32_t c = units[i];
+        if (c < 0x80) {
+            *out++ = static_cast<char>(c);
+        } else if (c < 0x800) {
+            *out++ = static_cast<char>(0xc0 | (c >> 6));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+        } else if (IsLeadSurrogate(c) && i + 1 < count && IsTrailSurrogate(units[i + 1])) {
+            c = 0x10000 + ((c - 0xd800) << 10) + (units[++i] - 0xdc00);
+            *out++ = static_cast<char>(0xf0 | (c >> 18));
+            *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            // lone surrogates included
+            *out++ = static_cast<char>(0xe0 | (c >> 12));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+    return out;
+}
+
+Wtf8String::Wtf8String(Local<Value> value) : _data(_inline), _length(0) {
+    if (!value->IsString()) {
+        return;
+    }
+
+    Local<String> str = value.As<String>();
+    const int chunk = 256;
+    int length = str->Length();
+    bool one_byte = str->IsOneByte() || str->ContainsOnlyOneByte();
+    size_t capacity = static_cast<size_t>(length) * (one_byte ? 2 : 3);
+    if (capacity > kInline) {
+        _data = static_cast<char *>(checked_malloc(capacity));
+    }
+    char *out = _data;
+
+    if (one_byte) {
+        // Latin-1, the common case, and ASCII goes straight through
+        uint8_t buffer[chunk];
+        for (int start = 0; start < length; start += chunk) {
+#if NODE_MODULE_VERSION >= NODE_12_0_MODULE_VERSION
+            int written = str->WriteOneByte(Isolate::GetCurrent(), buffer, start, chunk, String::NO_NULL_TERMINATION);
+#else
+            int written = str->WriteOneByte(buffer, start, chunk, String::NO_NULL_TERMINATION);
+#endif
+            for (int i = 0; i < written; i++) {
+                uint8_t c = buffer[i];
+                if (c < 0x80) {
+                    *out++ = static_cast<char>(c);
+                } else {
+                    *out++ = static_cast<char>(0xc0 | (c >> 6));
+                    *out++ = static_cast<char>(0x80 | (c & 0x3f));
+                }
+            }
+        }
+    } else {
+        // one extra unit for a lead surrogate carried over from the last
+        // chunk, which may pair with the first unit of this one
+        uint16_t buffer[chunk + 1];
+        int carried = 0;
+        for (int start = 0; start < length; start += chunk) {
+#if NODE_MODULE_VERSION >= NODE_12_0_MODULE_VERSION
+            int written = str->Write(Isolate::GetCurrent(), buffer + carried, start, chunk, String::NO_NULL_TERMINATION);
+#else
+            int written = str->Write(buffer + carried, start, chunk, String::NO_NULL_TERMINATION);
+#endif
+            int count = carried + written;
+            carried = start + written < length && count > 0 && IsLeadSurrogate(buffer[count - 1]) ? 1 : 0;
+            out = EncodeUnits(buffer, count - carried, out);
+            if (carried) {
+                buffer[0] = buffer[count - 1];
+            }
+        }
+        out = EncodeUnits(buffer, carried, out);
+    }
+    _length = out - _data;
+}
+
+Wtf8String::~Wtf8String() {
+    if (_data != _inline) {
+        free(_data);
+    }
+}
+
+Local<String> wtf8_to_string(const char *data, size_t length) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+
+    // without an encoded surrogate (ED A0..BF) the bytes are plain UTF-8
+    bool surrogates = false;
+    for (size_t i = 0; i + 1 < length && !surrogates; i++) {
+        surrogates = bytes[i] == 0xed && bytes[i + 1] >= 0xa0;
+    }
+    if (!surrogates) {
+        return Nan::New<String>(data, static_cast<int>(length)).ToLocalChecked();
+    }
+
+    std::vector<uint16_t> units;
+    units.reserve(length);
+    for (size_t i = 0; i < length; ) {
+        uint32_t c = bytes[i];
+        size_t extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+        if (extra != 0) {
+            c &= 0x3f >> extra;
+        }
+        if (i + extra >= length) {
+            extra = length - i - 1;
+        }
+        for (size_t k = 1; k <= extra; k++) {
+            c = (c << 6) | (bytes[i + k] & 0x3f);
+        }
+        i += extra + 1;
+
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            units.push_back(static_cast<uint16_t>(0xd800 + (c >> 10)));
+            units.push_back(static_cast<uint16_t>(0xdc00 + (c & 0x3ff)));
+        } else {
+            units.push_back(static_cast<uint16_t>(c));
+        }
+    }
+    return Nan::New<String>(units.data(), static_cast<int>(units.size())).ToLocalChecked();
+}
@@ -0,0 +1,44 @@
+#ifndef WTF8_H
+#define WTF8_H
+
+#include <stddef.h>
+#include <node.h>
+#include <nan.h>
+
+// JS strings are UTF-16 and can hold lone surrogates, which UTF-8 can't:
+// Nan::Utf8String turns each of them into U+FFFD, so two different keys
+// would come out as the same bytes. Native string keys are kept as WTF-8
+// instead, UTF-8 that also encodes a lone surrogate the way it would a
+// BMP character. Every string has exactly one encoding, and a string
+// without lone surrogates is encoded the same as in UTF-8
+
+// the WTF-8 bytes of a string, in a buffer on the stack unless it's long.
+// Empty if the value isn't a string
+class Wtf8String {
+public:
+    explicit Wtf8String(v8::Local<v8::Value> value);
+    ~Wtf8String();
+
+    const char *operator*() const {
+        return _data;
+    }
+
+    size_t length() const {
+        return _length;
+    }
+
+private:
+    Wtf8String(const Wtf8String &);
+    Wtf8String &operator=(const Wtf8String &);
+
+    static const size_t kInline = 256;
+
+    char _inline[kInline];
+    char *_data;
+    size_t _length;
+};
+
+// the string WTF-8 bytes encode
+v8::Local<v8::String> wtf8_to_string(const char *data, size_t length);
+
+#endif
@@ -51,6 +51,18 @@ const test = require('tape');
     assert.end();
   });
 
+  test(`test ${mapType} NaN and zero keys`, (assert) => {
+    // keys are compared with SameValueZero, like === except for NaN
+    const m = new Map([[NaN, 'nan'], [0, 'zero']]);
+    assert.ok(m.has(NaN), 'has returns true for a NaN key');
+    assert.equal(m.get(0 / 0), 'nan', 'any NaN finds it');
+    assert.equal(m.get(-0), 'zero', '-0 finds 0');
+    m.set(NaN, 'again');
+    assert.equal(m.size, 2, 'setting NaN again replaces it');
+    assert.ok(m.delete(NaN) && !m.has(NaN), 'and it can be deleted');
+    assert.end();
+  });
+
   test(`test ${mapType} delete method`, (assert) => {
     const m = new Map([[1,2],[3,4]]);
     const startSize = m.size;
@@ -149,6 +161,24 @@ const test = require('tape');
   });
 
 
+  test(`test ${mapType} deleting while iterating`, (assert) => {
+    const myMap = new Map([[0, 'zero'], [1, 'one'], [2, 'two'], [3, 'three']]);
+
+    const keys = [];
+    for (let key of myMap.keys()) {
+      keys.push(key);
+      if (keys.length === 1) {
+        // delete everything except the key just visited
+        [0, 1, 2, 3].filter((k) => k !== key).forEach((k) => myMap.delete(k));
+      }
+    }
+    assert.equal(keys.length, 1, 'entries deleted during iteration are not visited');
+    assert.equal(myMap.size, 1, 'size reflects deletes made during iteration');
+    assert.ok(myMap.has(keys[0]), 'the visited key is still there');
+    assert.end();
+  });
+
+
   test(`test ${mapType} relation with Array objects`, (assert) => {
     const kvArray = [['key1', 'value1'], ['key2', 'value2']];
     let myMap;
@@ -196,3 +226,534 @@ const test = require('tape');
   });
 
 });
+
+test('test native batch methods', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  assert.equal(m.setMany([['a', 1], ['b', 2]]), 2, 'setMany with entries returns the number of keys added');
+  assert.equal(m.setMany(['b', 'c'], [3, 4]), 1, 'setMany with keys and values only counts new keys');
+  assert.equal(m.get('b'), 3, 'setMany replaces existing values');
+  assert.throws(() => {m.setMany(['d'], [1, 2]);}, TypeError, 'keys and values have to be the same length');
+  assert.throws(() => {m.setMany([1, 2]);}, TypeError, 'cannot setMany from a flat array');
+  assert.deepEquals(m.getMany(['a', 'c', 'x']), [1, 4, undefined], 'getMany returns values in key order');
+  assert.deepEquals(m.hasMany(['a', 'x']), [true, false], 'hasMany returns booleans in key order');
+  assert.equal(m.deleteMany(['a', 'x', 'c']), 2, 'deleteMany returns the number of keys deleted');
+  assert.equal(m.size, 1, 'deleteMany removes the keys');
+  assert.end();
+});
+
+test('test native iterator nextBatch', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map([['a', 1], ['b', 2], ['c', 3]]);
+  m.delete('b');
+  const keys = m.keys();
+  const batch = [];
+  assert.equal(keys.nextBatch(1, batch), batch, 'nextBatch fills the array it is given');
+  assert.deepEquals(batch, ['a'], 'nextBatch returns up to count keys');
+  assert.deepEquals(keys.nextBatch(5, batch), ['c'], 'nextBatch skips deleted entries and truncates the array');
+  assert.deepEquals(keys.nextBatch(5, batch), [], 'nextBatch returns an empty array when done');
+  assert.deepEquals(m.entries().nextBatch(5), ['a', 1, 'c', 3], 'entries are flattened into key, value pairs');
+  assert.deepEquals(m.values().nextBatch(5), [1, 3], 'values can be batched');
+  assert.throws(() => {m.keys().nextBatch(0);}, TypeError, 'count has to be positive');
+  assert.end();
+});
+
+test('test native construction and sizing', (assert) => {
+  const Map = require('../index.js');
+  const source = new Map([['a', 1], ['b', 2], ['c', 3]]);
+  source.delete('b');
+  const copy = new Map(source);
+  assert.deepEquals(Array.from(copy), [['a', 1], ['c', 3]], 'a map can be copied from another map');
+  copy.set('d', 4);
+  assert.notOk(source.has('d'), 'the copy is independent of the source');
+  assert.equal(new Map(null).size, 0, 'null makes an empty map');
+  const sized = new Map(undefined, {capacity: 1000});
+  assert.doesNotThrow(() => {sized.reserve(5000);}, 'reserve takes an entry count');
+  assert.throws(() => {sized.reserve(-1);}, TypeError, 'reserve needs a count');
+  assert.throws(() => {new Map(null, {capacity: 'big'});}, TypeError, 'capacity has to be a number');
+  for (let i = 0; i < 100; i++) {
+    sized.set(i, i);
+  }
+  for (let i = 10; i < 100; i++) {
+    sized.delete(i);
+  }
+  assert.doesNotThrow(() => {sized.shrinkToFit();}, 'shrinkToFit can be called');
+  assert.equal(sized.size, 10, 'shrinkToFit keeps every entry');
+  assert.equal(sized.get(9), 9, 'entries can be found after shrinkToFit');
+  sized.set(100, 100);
+  assert.equal(sized.get(100), 100, 'entries can be added after shrinkToFit');
+  assert.end();
+});
+
+test('test native size and lookups while the index is rebuilt', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  const keys = m.keys();
+  keys.next(); // an iterator stays open the whole time
+  let ok = true;
+  for (let i = 0; i < 20000; i++) {
+    m.set(i, i);
+    if (i % 3 === 0) {
+      m.delete(i - 1);
+    }
+    if (m.get(i >> 1) !== ((i >> 1) % 3 === 2 && (i >> 1) + 1 <= i ? undefined : i >> 1)) {
+      ok = false;
+    }
+  }
+  assert.ok(ok, 'every key can be found while the table grows');
+  assert.equal(m.size, 20000 - 6666, 'size counts live entries');
+  assert.end();
+});
+
+test('test native deletes of keys already moved to the rebuilt index', (assert) => {
+  const NodeMap = require('../index.js');
+  const tables = [
+    ['NodeMap', new NodeMap(), 'set', (i) => i],
+    ['NumberMap', new NodeMap.NumberMap(), 'set', (i) => i],
+    ['StringMap', new NodeMap.StringMap(), 'set', (i) => 'key ' + i],
+    ['NodeSet', new NodeMap.NodeSet(), 'add', (i) => 'key ' + i],
+  ];
+  tables.forEach(([name, m, add, key]) => {
+    const expected = new Set();
+    let ok = true;
+    // past 4096 slots the index is rebuilt a step at a time, and the low
+    // positions are the first ones moved over
+    for (let i = 0; i < 10000; i++) {
+      m[add](key(i), i);
+      expected.add(key(i));
+      if (i % 2 === 0) {
+        const old = key(i >> 1);
+        m.delete(old);
+        ok = ok && !m.has(old) && !m.delete(old);
+        m[add](old, i);
+        ok = ok && m.has(old) && m.delete(old) && !m.has(old) && !m.delete(old);
+        expected.delete(old);
+      }
+    }
+    assert.ok(ok, name + ' finds no deleted keys while the index is rebuilt');
+    assert.equal(m.size, expected.size, name + ' size counts live entries');
+  });
+  assert.end();
+});
+
+test('test native ordered mode', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map(null, {ordered: true});
+  for (let i = 0; i < 1000; i++) {
+    m.set('k' + i, i);
+  }
+  for (let i = 0; i < 1000; i++) {
+    if (i % 10 !== 0) {
+      m.delete('k' + i);
+    }
+  }
+  m.set('k0', 'first');
+  m.set('last', -1);
+  const expected = [];
+  for (let i = 0; i < 1000; i += 10) {
+    expected.push('k' + i);
+  }
+  expected.push('last');
+  assert.deepEquals(Array.from(m.keys()), expected, 'keys come back in insertion order after deletes');
+  assert.equal(m.get('k0'), 'first', 'setting an existing key keeps its place and updates its value');
+
+  const iter = m.keys();
+  const seen = [iter.next().value];
+  m.delete('k10');
+  m.delete('k20');
+  for (let item = iter.next(); !item.done; item = iter.next()) {
+    seen.push(item.value);
+  }
+  assert.deepEquals(seen, expected.filter((k) => k !== 'k10' && k !== 'k20'), 'keys deleted while iterating are skipped');
+  assert.end();
+});
+
+test('test native array store', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map([['a', 1], [2, 'b'], [true, {c: 3}]], {store: 'array'});
+  assert.equal(m.get('a'), 1, 'string keys can be found');
+  assert.equal(m.get(2), 'b', 'number keys can be found');
+  assert.deepEquals(m.get(true), {c: 3}, 'values come back');
+  m.set('a', 10);
+  assert.equal(m.get('a'), 10, 'values can be replaced');
+  assert.ok(m.delete(2), 'keys can be deleted');
+  assert.notOk(m.has(2), 'deleted keys are gone');
+  assert.deepEquals(Array.from(m).sort(), [['a', 10], [true, {c: 3}]].sort(), 'entries can be iterated');
+
+  const copy = new Map(m);
+  assert.equal(copy.get('a'), 10, 'a handle map can be copied from an array store map');
+
+  const ordered = new Map(null, {store: 'array', ordered: true});
+  for (let i = 0; i < 1000; i++) {
+    ordered.set(i, i * 2);
+  }
+  for (let i = 0; i < 990; i++) {
+    ordered.delete(i);
+  }
+  assert.deepEquals(Array.from(ordered.values()), [1980, 1982, 1984, 1986, 1988, 1990, 1992, 1994, 1996, 1998], 'values stay with their keys through compaction');
+  ordered.clear();
+  assert.equal(ordered.size, 0, 'an array store map can be cleared');
+
+  // chunks grow as they fill, and a full one is followed by a new one
+  const big = new Map(null, {store: 'array'});
+  for (let i = 0; i < 70000; i++) {
+    big.set(i, i * 2);
+  }
+  let same = 0;
+  for (let i = 0; i < 70000; i++) {
+    same += big.get(i) === i * 2 ? 1 : 0;
+  }
+  assert.equal(same, 70000, 'every value is kept as its chunk grows');
+  assert.throws(() => {new Map(null, {store: 'disk'});}, TypeError, 'store has to be a known kind');
+  assert.throws(() => {new Map(null, {store: {toString: () => 'array'}});}, TypeError, 'and a string');
+  assert.end();
+});
+
+test('test native serialized values', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map(null, {serialize: true});
+  const value = {name: 'a', list: [1, 2, 3], nested: {when: new Date(0)}};
+  m.set('a', value);
+  assert.deepEquals(m.get('a'), value, 'values come back equal');
+  assert.notEqual(m.get('a'), value, 'values come back as copies');
+  assert.ok(m.serializedBytes > 0, 'serializedBytes counts the stored values');
+  assert.throws(() => {m.set('f', () => {});}, 'values that cannot be serialized throw');
+  assert.notOk(m.has('f'), 'a value that cannot be serialized is not set');
+  m.delete('a');
+  assert.equal(m.serializedBytes, 0, 'deleting frees the serialized value');
+
+  m.setMany([['x', [1]], ['y', 'two']]);
+  const copy = new Map(m, {serialize: true});
+  assert.deepEquals(copy.get('x'), [1], 'serialized maps can be copied');
+  const plain = new Map(m);
+  assert.equal(plain.get('y'), 'two', 'a serialized map can be copied into a plain one');
+  assert.equal(new Map(null).serializedBytes, 0, 'plain maps hold no serialized bytes');
+  assert.end();
+});
+
+test('test native bounded maps', (assert) => {
+  const Map = require('../index.js');
+  const evicted = [];
+  const lru = new Map(null, {maxSize: 3, onEvict: (value, key) => {evicted.push([key, value]);}});
+  lru.set('a', 1).set('b', 2).set('c', 3);
+  lru.get('a');
+  lru.set('d', 4);
+  assert.equal(lru.size, 3, 'the map never grows past maxSize');
+  assert.notOk(lru.has('b'), 'the least recently used key is evicted');
+  assert.deepEquals(evicted, [['b', 2]], 'onEvict gets the evicted value and key');
+  lru.set('c', 30);
+  lru.set('e', 5);
+  assert.deepEquals(evicted, [['b', 2], ['a', 1]], 'setting a key counts as using it');
+  lru.delete('d');
+  lru.set('f', 6);
+  assert.equal(evicted.length, 2, 'deleting makes room without evicting');
+
+  const ordered = new Map(null, {maxSize: 100, ordered: true});
+  for (let i = 0; i < 1000; i++) {
+    ordered.set(i, i);
+    ordered.get(i - 50);
+  }
+  assert.equal(ordered.size, 100, 'bounded ordered maps stay bounded through compaction');
+  assert.ok(ordered.has(950), 'recently used keys survive compaction');
+
+  const clock = new Map(null, {maxSize: 2, policy: 'clock'});
+  clock.set('a', 1).set('b', 2);
+  clock.get('a');
+  clock.set('c', 3);
+  assert.ok(clock.has('a') && !clock.has('b'), 'clock skips entries used since the hand last passed');
+
+  assert.throws(() => {new Map(null, {maxSize: 0});}, TypeError, 'maxSize has to be positive');
+  assert.throws(() => {new Map(null, {policy: 'lru'});}, TypeError, 'a policy needs a maxSize');
+  assert.throws(() => {new Map(null, {maxSize: 1, policy: 'fifo'});}, TypeError, 'policy has to be a known one');
+  assert.throws(() => {new Map(null, {maxSize: 1, policy: {toString: () => 'lru'}});}, TypeError, 'and a string');
+  assert.end();
+});
+
+test('test native stats', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  for (let i = 0; i < 1000; i++) {
+    m.set(i, i);
+  }
+  for (let i = 0; i < 100; i++) {
+    m.delete(i);
+  }
+  const stats = m.stats();
+  assert.equal(stats.size, 900, 'stats has the size');
+  assert.ok(stats.capacity >= stats.size, 'the index has room for every entry');
+  assert.equal(stats.loadFactor, stats.size / stats.capacity, 'loadFactor is size over capacity');
+  assert.ok(stats.maxProbe >= 1 && stats.averageProbe >= 1 && stats.averageProbe <= stats.maxProbe, 'probe lengths are counted in groups');
+  assert.ok(stats.rehashes > 0, 'growing the table rehashes it');
+  assert.ok(stats.nativeBytes > 0, 'the table takes native memory');
+  assert.equal(stats.counters, null, 'operations are not counted by default');
+
+  const iterator = m.keys();
+  assert.equal(m.stats().iterators, 1, 'open iterators are counted');
+  Array.from(iterator);
+
+  const bounded = new Map(null, {maxSize: 2});
+  bounded.countOperations(true);
+  bounded.set('a', 1).set('b', 2).set('c', 3);
+  bounded.get('c');
+  bounded.get('a');
+  bounded.has('b');
+  bounded.delete('b');
+  assert.deepEquals(bounded.stats().counters, {hits: 2, misses: 1, inserts: 3, deletes: 1, evictions: 1, expirations: 0}, 'counters count every operation');
+  bounded.countOperations(false);
+  assert.equal(bounded.stats().counters, null, 'counting can be turned off');
+  assert.throws(() => {bounded.countOperations();}, TypeError, 'countOperations takes a boolean');
+  assert.end();
+});
+
+test('test native hashing', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  // strings that look like array indexes, and numbers that only differ in
+  // their high bits
+  for (let i = 0; i < 50000; i++) {
+    m.set(String(i * 4096), i);
+    m.set(i * 4096 + 0.5, i);
+  }
+  const stats = m.stats();
+  assert.equal(stats.size, 100000, 'every key is there');
+  assert.ok(stats.maxProbe < 32, 'probe sequences stay short');
+  assert.equal(m.get('4096'), 1, 'keys are found again');
+  assert.equal(new Map(m).get(4096.5), 1, 'a copy keeps hashing the same way');
+  // strings are hashed by their contents, however V8 happens to hold them
+  const long = 'é'.repeat(300) + 'x';
+  m.set(long, 'long');
+  assert.equal(m.get('é'.repeat(150) + 'é'.repeat(150) + 'x'), 'long', 'a concatenated string finds a flat one');
+  assert.equal(m.get(('☃' + long).slice(1)), 'long', 'a slice of a two byte string finds a one byte one');
+  assert.end();
+});
+
+test('test native composite keys', (assert) => {
+  const Map = require('../index.js');
+  const user = {id: 1};
+  const m = new Map();
+  assert.equal(m.set2(user, 'read', true), m, 'set2 returns the map');
+  m.set3('a', 1, 2.5, 'abc');
+  assert.equal(m.get2(user, 'read'), true, 'get2 finds a pair of parts');
+  assert.equal(m.get2({id: 1}, 'read'), undefined, 'object parts are compared by identity');
+  assert.equal(m.get3('a', 1, 2.5), 'abc', 'get3 finds three parts');
+  assert.notOk(m.has2('a', 1), 'a prefix is a different key');
+  m.set(['a', 1], 'array');
+  assert.equal(m.get2('a', 1), undefined, 'an array key is not a composite key');
+  assert.equal(m.get(['a', 1]), undefined, 'nor the other way around');
+  const key = Array.from(m.keys())[0];
+  assert.deepEquals(key, [user, 'read'], 'iterating yields the parts');
+  assert.ok(Object.isFrozen(key), 'as a frozen array');
+  assert.equal(m.get(key), undefined, 'which is not a key for get');
+  assert.throws(() => {m.get2('a', null);}, TypeError, 'no part can be null');
+  assert.ok(m.delete2(user, 'read') && !m.has2(user, 'read'), 'delete2 deletes the key');
+
+  const arrays = new Map(null, {store: 'array', ordered: true});
+  for (let i = 0; i < 1000; i++) {
+    arrays.set2(i, String(i), i);
+  }
+  assert.equal(arrays.get2(500, '500'), 500, 'works with the array store');
+  assert.equal(arrays.get2(500, 500), undefined, 'parts keep their types');
+  assert.end();
+});
+
+test('test native composite keys with NaN parts', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  assert.ok(m.set2(NaN, 'nan', 1).has2(NaN, 'nan'), 'a NaN part finds NaN');
+  assert.equal(m.get2(-0, 'nan'), undefined, 'but not other numbers');
+  m.set2(0, 'zero', 2);
+  assert.equal(m.get2(-0, 'zero'), 2, 'and -0 finds 0');
+  assert.end();
+});
+
+test('test native upserts', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  assert.equal(m.getOrSet('a', 1), 1, 'getOrSet sets a missing key');
+  assert.equal(m.getOrSet('a', 2), 1, 'and gets one that is there');
+  assert.equal(m.getOrSet('b', (key) => key + '!'), 'b!', 'a function makes the value');
+  assert.equal(m.update('a', (value, key) => key + value), 'a1', 'update gets the old value');
+  assert.equal(m.update('c', (value) => value), undefined, 'and undefined for a missing key');
+  assert.ok(m.has('c'), 'which it sets too');
+  assert.equal(m.increment('n'), 1, 'increment starts from 0');
+  assert.equal(m.increment('n', 2.5), 3.5, 'and adds delta');
+  assert.equal(m.get('n'), 3.5, 'the count is a plain number');
+  assert.throws(() => {m.increment('a');}, TypeError, 'only numbers can be incremented');
+  assert.deepEquals(Array.from(m.keys()).sort(), ['a', 'b', 'c', 'n'], 'iteration sees every key');
+  m.set('n', 10);
+  assert.equal(m.increment('n', -1), 9, 'a set number can be incremented too');
+
+  [{store: 'array'}, {serialize: true}, {ordered: true}].forEach((option) => {
+    const counts = new Map(null, option);
+    for (let i = 0; i < 10000; i++) {
+      counts.increment(i % 200);
+      counts.set('temporary', i);
+      counts.delete('temporary');
+    }
+    assert.equal(counts.get(99), 50, 'counts every key with ' + JSON.stringify(option));
+    assert.equal(new Map(counts).get(99), 50, 'a copy has the counts');
+  });
+
+  const bounded = new Map(null, {maxSize: 10});
+  for (let i = 0; i < 100; i++) {
+    bounded.increment(i);
+  }
+  assert.equal(bounded.size, 10, 'a new count evicts like a set');
+  assert.equal(bounded.increment(99), 2, 'and the newest ones are kept');
+  assert.end();
+});
+
+test('test native whole map operations', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map(null, {maxSize: 100});
+  for (let i = 0; i < 10; i++) {
+    m.set(i, 'v' + i);
+  }
+  m.set2('a', 1, 'composite');
+  m.get(0);
+
+  const copy = m.clone();
+  assert.ok(copy instanceof Map && copy !== m, 'clone makes a new map');
+  assert.deepEquals(copy.entriesArray(), m.entriesArray(), 'with the same entries');
+  assert.equal(copy.get2('a', 1), 'composite', 'composite keys still work');
+  const small = m.filter(() => true);
+  for (let i = 10; i < 100; i++) {
+    copy.set(i, i);
+  }
+  assert.equal(copy.size, 100, 'and the same maxSize');
+  assert.ok(copy.has(0) && !copy.has(1), 'and the same recency');
+
+  assert.deepEquals(m.keysArray().filter((k) => typeof k === 'number').sort(), [0, 1, 2, 3, 4, 5, 6, 7, 8, 9], 'keysArray has every key');
+  assert.equal(m.valuesArray().length, 11, 'valuesArray has every value');
+  assert.deepEquals(m.entriesArray().find((e) => e[0] === 3), [3, 'v3'], 'entriesArray has [key, value] pairs');
+
+  const evens = m.filter((value, key, map) => {
+    assert.equal(map, m, 'filter gets the map');
+    return typeof key === 'number' && key % 2 === 0;
+  });
+  assert.deepEquals(evens.keysArray().sort(), [0, 2, 4, 6, 8], 'filter keeps what the function says');
+  assert.equal(small.size, 11, 'and can keep everything');
+
+  const target = new Map([[0, 'old'], ['x', 'x']]);
+  assert.equal(target.merge(m, {overwrite: false}), 10, 'merge returns how many keys it added');
+  assert.equal(target.get(0), 'old', 'and keeps existing values without overwrite');
+  assert.equal(target.get2('a', 1), 'composite', 'merged composite keys are found');
+  target.merge(m);
+  assert.equal(target.get(0), 'v0', 'overwrites them by default');
+  assert.equal(target.size, 12, 'without adding any key twice');
+  assert.throws(() => {target.merge({});}, TypeError, 'only merges another NodeMap');
+
+  const expiring = new Map(null, {ttl: 20});
+  expiring.set('a', 1);
+  expiring.set('b', 2, {ttl: 0});
+  const cloned = expiring.clone();
+  const filtered = expiring.filter(() => true);
+  setTimeout(() => {
+    assert.deepEquals(cloned.keysArray(), ['b'], 'clones keep their expiry times');
+    assert.deepEquals(filtered.keysArray(), ['b'], 'filtered maps too');
+    assert.end();
+  }, 50);
+});
+
+test('test native memory usage', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map();
+  const empty = m.memoryUsage();
+  assert.ok(empty > 0, 'an empty map still takes some native memory');
+  const external = process.memoryUsage().external;
+  for (let i = 0; i < 100000; i++) {
+    m.set(i, i);
+  }
+  const full = m.memoryUsage();
+  assert.ok(full > empty + 100000 * 8, 'memoryUsage grows with the map');
+  assert.equal(m.stats().nativeBytes, full, 'memoryUsage is what stats reports');
+  assert.ok(process.memoryUsage().external - external >= full - empty - 64 * 1024, 'V8 is told about the growth');
+  m.clear();
+  m.shrinkToFit();
+  assert.ok(m.memoryUsage() < full, 'clear and shrinkToFit give memory back');
+  assert.end();
+});
+
+test('test native ttl expiry', (assert) => {
+  const Map = require('../index.js');
+  const expired = [];
+  const m = new Map(null, {onExpire: (value, key) => {expired.push(key);}});
+  m.set('short', 1, {ttl: 20});
+  m.set('long', 2, {ttl: 60000});
+  m.set('forever', 3);
+  m.set('reset', 4, {ttl: 20});
+  m.set('reset', 5);
+  assert.throws(() => {m.set('bad', 1, {ttl: -1});}, TypeError, 'ttl has to be a whole number of milliseconds');
+  assert.equal(m.get('short'), 1, 'entries are there until they expire');
+
+  setTimeout(() => {
+    assert.notOk(m.has('short'), 'entries are gone once their ttl ran out');
+    assert.equal(m.size, 3, 'size does not count expired entries');
+    assert.equal(m.get('reset'), 5, 'setting a key again without a ttl keeps it');
+    assert.deepEquals(expired, ['short'], 'onExpire is called for expired entries');
+
+    const defaults = new Map(null, {ttl: 10});
+    defaults.setMany([['a', 1], ['b', 2]]);
+    defaults.set('c', 3, {ttl: 0});
+    setTimeout(() => {
+      assert.deepEquals(Array.from(defaults.keys()), ['c'], 'the map wide ttl applies to every set without one');
+      m.clear();
+      assert.end();
+    }, 50);
+  }, 50);
+});
+
+test('test native ttl expiry in the background', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map(null, {
+    ttl: 10,
+    onExpire: (value, key, map) => {
+      assert.equal(key, 'a', 'the timer expires entries nobody looks at');
+      assert.equal(map, m, 'onExpire gets the map');
+      assert.end();
+    },
+  });
+  m.set('a', 1);
+  // keeps the process alive, the expiry timer doesn't
+  setTimeout(() => {}, 200);
+});
+
+test('test native upserts keep expiry', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map(null, {ttl: 20});
+  m.set('updated', 1);
+  m.set('counted', 1);
+  m.set('renewed', 1);
+  m.update('updated', (value) => value + 1);
+  m.increment('counted');
+  m.increment('renewed', 1, {ttl: 0});
+  m.increment('added');
+  m.update('forever', () => 1, {ttl: 0});
+  assert.throws(() => {m.increment('bad', 1, {ttl: -1});}, TypeError, 'increment checks its ttl');
+  m.countOperations(true);
+  m.update('updated', (value) => value);
+  m.increment('missing', 1, {ttl: 0});
+  assert.equal(m.stats().counters.hits, 1, 'update looks its key up like get');
+  assert.equal(m.stats().counters.misses, 1, 'and so does increment');
+  m.delete('missing');
+  setTimeout(() => {
+    assert.deepEquals(m.keysArray().sort(), ['forever', 'renewed'], 'update and increment keep an expiry unless given a ttl');
+    assert.end();
+  }, 50);
+});
+
+test('test native copy of an expiring map', (assert) => {
+  const Map = require('../index.js');
+  const m = new Map(null, {ttl: 100});
+  m.set('gone', 1, {ttl: 1});
+  m.set('a', 2);
+  m.set('b', 3, {ttl: 0});
+  setTimeout(() => {
+    const copy = new Map(m);
+    assert.deepEquals(copy.keysArray().sort(), ['a', 'b'], 'entries that already expired are not copied');
+    setTimeout(() => {
+      assert.deepEquals(copy.keysArray(), ['b'], 'the rest keep their expiry times');
+      assert.end();
+    }, 150);
+  }, 20);
+});
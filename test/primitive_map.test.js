@@ -0,0 +1,47 @@
+'use strict';
+
+const test = require('tape');
+const NodeMap = require('../index.js');
+
+test('test NumberMap', (assert) => {
+  const m = new NodeMap.NumberMap([[1, 'one'], [2.5, 'two and a half']]);
+  assert.equal(m.size, 2, 'can construct from an array of entries');
+  assert.equal(m.get(1), 'one', 'get returns the value for a number key');
+  assert.equal(m.get(2.5), 'two and a half', 'non-integer keys work');
+  assert.equal(m.get('1'), undefined, 'a string key is not the same as a number key');
+  assert.ok(m.set(-0, 'zero').has(0), '-0 and 0 are the same key');
+  assert.ok(m.set(NaN, 'nan').has(NaN), 'NaN finds NaN');
+  assert.throws(() => {m.set('a', 1);}, TypeError, 'cannot set a non-number key');
+  assert.ok(m.delete(1) && !m.has(1), 'can delete a key');
+  assert.deepEquals(Array.from(m.keys()).filter((k) => k === k).sort(), [0, 2.5], 'keys come back as numbers');
+  m.clear();
+  assert.equal(m.size, 0, 'can be cleared');
+  assert.end();
+});
+
+test('test StringMap', (assert) => {
+  const long = 'a key that is too long to be stored inline';
+  const m = new NodeMap.StringMap([['a', 1], [long, 2], ['ü', 3]]);
+  assert.equal(m.size, 3, 'can construct from an array of entries');
+  assert.equal(m.get('a'), 1, 'short keys work');
+  assert.equal(m.get(long), 2, 'long keys work');
+  assert.equal(m.get('ü'), 3, 'non-ascii keys work');
+  assert.notOk(m.has(1), 'a number key is not the same as a string key');
+  assert.throws(() => {m.set({}, 1);}, TypeError, 'cannot set a non-string key');
+  assert.deepEquals(Array.from(m.keys()).sort(), ['a', long, 'ü'].sort(), 'keys come back as strings');
+  const seen = [];
+  m.forEach((value, key) => seen.push([key, value]));
+  assert.deepEquals(seen.sort(), Array.from(m).sort(), 'forEach and entries agree');
+  assert.end();
+});
+
+test('test StringMap keys with lone surrogates', (assert) => {
+  const m = new NodeMap.StringMap([['\uD800', 'lead'], ['\uDC00', 'trail'], ['\uD83D\uDE00', 'pair']]);
+  assert.equal(m.size, 3, 'lone surrogates are different keys');
+  assert.equal(m.get('\uD800'), 'lead', 'a lone lead surrogate finds its own value');
+  assert.equal(m.get('\uDC00'), 'trail', 'a lone trail surrogate finds its own value');
+  assert.notOk(m.has('\uFFFD'), 'neither is the replacement character');
+  assert.notOk(m.has('\uD83D'), 'half of a pair is not the pair');
+  assert.deepEquals(Array.from(m.keys()).sort(), ['\uD800', '\uDC00', '\uD83D\uDE00'].sort(), 'keys come back as they went in');
+  assert.end();
+});
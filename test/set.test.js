@@ -0,0 +1,55 @@
+'use strict';
+
+const test = require('tape');
+const {NodeSet} = require('../index.js');
+
+test('test NodeSet', (assert) => {
+  const obj = {};
+  const s = new NodeSet(['a', 1, obj, 'a']);
+  assert.equal(s.size, 3, 'can construct from an iterable of values');
+  assert.ok(s.has('a') && s.has(1) && s.has(obj), 'has finds every value');
+  assert.notOk(s.has('1') || s.has({}), 'values are compared like ===');
+  assert.equal(s.add(2.5), s, 'add returns the set');
+  assert.equal(s.add(2.5).size, 4, 'adding a value twice keeps one');
+  assert.throws(() => {s.add(undefined);}, TypeError, 'undefined cannot be added');
+  assert.ok(s.delete('a') && !s.has('a'), 'can delete a value');
+  assert.notOk(s.delete('a'), 'delete returns false for a missing value');
+
+  const values = Array.from(s);
+  assert.deepEquals(values.slice().sort(), [1, 2.5, obj].sort(), 'iterates over the values');
+  assert.deepEquals(Array.from(s.keys()), values, 'keys are the values');
+  assert.deepEquals(Array.from(s.entries()), values.map((v) => [v, v]), 'entries are [value, value]');
+  const seen = [];
+  s.forEach((value, key, set) => {
+    assert.equal(key, value, 'forEach gets the value twice');
+    assert.equal(set, s, 'and the set');
+    seen.push(value);
+  });
+  assert.deepEquals(seen, values, 'forEach and the iterator agree');
+  assert.equal(new NodeSet(s).size, 3, 'a set can be copied');
+  s.clear();
+  assert.equal(s.size, 0, 'can be cleared');
+  assert.end();
+});
+
+test('test NodeSet algebra', (assert) => {
+  const evens = new NodeSet();
+  const threes = new NodeSet();
+  for (let i = 0; i < 3000; i++) {
+    evens.add(i * 2);
+    threes.add(i * 3);
+  }
+  const sorted = (set) => Array.from(set).sort((a, b) => a - b);
+  const union = evens.union(threes);
+  assert.ok(union instanceof NodeSet, 'union is a NodeSet');
+  assert.equal(union.size, 3000 + 2000, 'union has every value once');
+  assert.deepEquals(sorted(evens.intersection(threes)), sorted(threes.intersection(evens)), 'intersection goes both ways');
+  assert.equal(evens.intersection(threes).size, 1000, 'intersection has the shared values');
+  assert.ok(evens.intersection(threes).has(5994), 'up to the last one');
+  assert.equal(evens.difference(threes).size, 2000, 'difference drops the shared values');
+  assert.equal(threes.difference(new NodeSet([0, 3])).size, 2998, 'with a smaller set too');
+  assert.notOk(evens.difference(threes).has(6), 'shared values are gone');
+  assert.equal(evens.size, 3000, 'the sets themselves are left alone');
+  assert.throws(() => {evens.union([1, 2]);}, TypeError, 'only works with another NodeSet');
+  assert.end();
+});
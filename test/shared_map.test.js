@@ -0,0 +1,72 @@
+'use strict';
+
+const test = require('tape');
+const {SharedMap} = require('../index.js');
+
+let workerThreads;
+try {
+  workerThreads = require('worker_threads');
+} catch (e) {
+  workerThreads = null;
+}
+
+test('test SharedMap basics', (assert) => {
+  const m = new SharedMap('basics');
+  assert.equal(m.name, 'basics', 'the map knows its name');
+  assert.equal(m.set('a', {list: [1, 2]}), m, 'set returns the map');
+  m.set(1, 'one');
+  m.set(-0, 'zero');
+  assert.deepEquals(m.get('a'), {list: [1, 2]}, 'values are copied out');
+  assert.equal(m.get(1), 'one', 'number keys work');
+  assert.equal(m.get(0), 'zero', '-0 and 0 are the same key');
+  assert.notOk(m.has('1'), 'numbers and strings are different keys');
+  assert.equal(new SharedMap('basics').get(1), 'one', 'a map opened by the same name shares the table');
+  assert.equal(new SharedMap('other').size, 0, 'other names are other tables');
+  assert.throws(() => {m.set({}, 1);}, TypeError, 'keys have to be numbers or strings');
+  assert.throws(() => {m.set('f', () => {});}, 'values have to be serializable');
+
+  const seen = {};
+  m.forEach((value, key) => {seen[key] = value;});
+  assert.deepEquals(seen, {a: {list: [1, 2]}, 1: 'one', 0: 'zero'}, 'forEach visits every entry');
+  assert.ok(m.delete('a'), 'keys can be deleted');
+  assert.equal(m.size, 2, 'size counts every shard');
+  m.clear();
+  assert.equal(m.size, 0, 'clear empties the map');
+  assert.end();
+});
+
+test('test SharedMap keys with lone surrogates', (assert) => {
+  const m = new SharedMap('surrogates');
+  m.set('\uD800', 'lead');
+  m.set('\uDC00', 'trail');
+  assert.equal(m.size, 2, 'lone surrogates are different keys');
+  assert.equal(m.get('\uDC00'), 'trail', 'each finds its own value');
+  const keys = [];
+  m.forEach((value, key) => keys.push(key));
+  assert.deepEquals(keys.sort(), ['\uD800', '\uDC00'].sort(), 'keys come back as they went in');
+  m.clear();
+  assert.end();
+});
+
+test('test SharedMap across worker threads', {skip: !workerThreads}, (assert) => {
+  const m = new SharedMap('threads');
+  m.set('from main', 1);
+
+  const worker = new workerThreads.Worker(`
+    const {parentPort} = require('worker_threads');
+    const {SharedMap} = require(${JSON.stringify(require.resolve('../index.js'))});
+    const m = new SharedMap('threads');
+    m.set('from worker', m.get('from main') + 1);
+    parentPort.postMessage('done');
+  `, {eval: true});
+
+  worker.on('error', (err) => {
+    assert.fail(err);
+    assert.end();
+  });
+  worker.on('message', () => {
+    assert.equal(m.get('from worker'), 2, 'a worker reads and writes the same table');
+    worker.terminate();
+    assert.end();
+  });
+});
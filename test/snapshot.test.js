@@ -0,0 +1,96 @@
+'use strict';
+
+const test = require('tape');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const NodeMap = require('../index.js');
+const {SharedMap} = NodeMap;
+
+const file = path.join(os.tmpdir(), `es6-native-map-${process.pid}.snap`);
+
+test('test snapshot round trip', (assert) => {
+  const m = new NodeMap();
+  for (let i = 0; i < 1000; i++) {
+    m.set(i, {square: i * i});
+    m.set(`key ${i}`, [i]);
+  }
+  m.set(-0, 'zero');
+  m.delete(500);
+
+  m.saveSnapshot(file);
+  assert.notOk(fs.existsSync(`${file}.tmp`), 'the temporary file is renamed');
+
+  const s = NodeMap.openSnapshot(file);
+  assert.ok(s instanceof NodeMap.SnapshotMap, 'openSnapshot returns a SnapshotMap');
+  assert.equal(s.size, m.size, 'the snapshot has every entry');
+  assert.deepEquals(s.get(42), {square: 1764}, 'number keys work');
+  assert.deepEquals(s.get('key 7'), [7], 'string keys work');
+  assert.equal(s.get(0), 'zero', '-0 and 0 are the same key');
+  assert.ok(s.has(999), 'has finds keys');
+  assert.notOk(s.has(500), 'deleted keys are not saved');
+  assert.notOk(s.has('42'), 'numbers and strings are different keys');
+  assert.equal(s.get({}), undefined, 'other keys are never there');
+
+  let count = 0;
+  s.forEach((value, key) => {
+    assert.deepEquals(value, m.get(key), `forEach sees ${key}`);
+    count++;
+  });
+  assert.equal(count, m.size, 'forEach visits every entry');
+
+  s.close();
+  assert.equal(s.size, 0, 'a closed snapshot is empty');
+  assert.equal(s.get(42), undefined, 'a closed snapshot finds nothing');
+  assert.end();
+});
+
+test('test snapshot keys with lone surrogates', (assert) => {
+  new NodeMap([['\uD800', 'lead'], ['\uDC00', 'trail']]).saveSnapshot(file);
+  const s = NodeMap.openSnapshot(file);
+  assert.equal(s.size, 2, 'lone surrogates are different keys');
+  assert.equal(s.get('\uD800'), 'lead', 'each finds its own value');
+  const keys = [];
+  s.forEach((value, key) => keys.push(key));
+  assert.deepEquals(keys.sort(), ['\uD800', '\uDC00'].sort(), 'keys come back as they went in');
+  s.close();
+  fs.unlinkSync(file);
+  assert.end();
+});
+
+test('test SharedMap.loadAsync', (assert) => {
+  const m = new NodeMap();
+  for (let i = 0; i < 1000; i++) {
+    m.set(`key ${i}`, {i});
+  }
+  m.saveSnapshot(file);
+
+  let called = false;
+  SharedMap.loadAsync('loaded', file, (err, shared) => {
+    called = true;
+    assert.error(err, 'the snapshot loads');
+    assert.equal(shared.name, 'loaded', 'the callback gets the map');
+    assert.equal(shared.size, 1000, 'every entry is loaded');
+    assert.deepEquals(new SharedMap('loaded').get('key 7'), {i: 7}, 'the table is shared by name');
+
+    SharedMap.loadAsync('missing', `${file}.missing`, (err) => {
+      assert.ok(err instanceof Error, 'a missing file is an error');
+      assert.end();
+    });
+  });
+  assert.notOk(called, 'the callback runs later');
+});
+
+test('test snapshot errors', (assert) => {
+  const m = new NodeMap([[{}, 1]]);
+  assert.throws(() => {m.saveSnapshot(file);}, TypeError, 'keys have to be numbers or strings');
+  assert.throws(() => {new NodeMap([[1, () => {}]]).saveSnapshot(file);}, 'values have to be serializable');
+
+  fs.writeFileSync(file, 'not a snapshot');
+  assert.throws(() => {NodeMap.openSnapshot(file);}, /not a snapshot/, 'other files are refused');
+  assert.throws(() => {NodeMap.openSnapshot(`${file}.missing`);}, /Could not open/, 'missing files throw');
+  assert.throws(() => {new NodeMap.SnapshotMap();}, TypeError, 'a SnapshotMap can only come from openSnapshot');
+
+  fs.unlinkSync(file);
+  assert.end();
+});